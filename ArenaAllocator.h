@@ -0,0 +1,148 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <new>
+#include <sys/mman.h>
+
+// reserved region of address space shared by ArenaAllocator and all its rebound copies
+// it is mapped on first allocation, so allocators that never allocate, like the ones of empty lists, cost nothing
+template <unsigned long capacity>
+struct ArenaRegion {
+    // recycled slots of one size, every free slot starts with pointer to the next one
+    struct FreeList {
+        std::size_t slot_size;
+        void* head = nullptr;
+
+        explicit FreeList(std::size_t slot_size) : slot_size(slot_size) {}
+    };
+
+    char* begin = nullptr;
+    std::size_t used = 0; // bytes
+    std::deque<FreeList> free_lists; // few of them, they don't move when new ones are added
+
+    ArenaRegion() = default;
+    ArenaRegion(const ArenaRegion&) = delete;
+    ArenaRegion& operator=(const ArenaRegion&) = delete;
+    ~ArenaRegion() {
+        if (begin)
+            munmap(begin, capacity);
+    }
+
+    void* allocate(std::size_t bytes, std::size_t alignment){
+        if (not begin) {
+            void* memory = mmap(nullptr, capacity, PROT_READ | PROT_WRITE,
+                                MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            if (memory == MAP_FAILED)
+                throw std::bad_alloc();
+            begin = static_cast<char*>(memory);
+        }
+        std::size_t start = (used + alignment - 1) / alignment * alignment;
+        if (start + bytes > capacity)
+            throw std::bad_alloc();
+        used = start + bytes;
+        return begin + start;
+    }
+
+    FreeList* find(std::size_t slot_size) noexcept {
+        for (FreeList& list : free_lists)
+            if (list.slot_size == slot_size)
+                return &list;
+        return nullptr;
+    }
+
+    void release() noexcept {
+        if (begin)
+            madvise(begin, used, MADV_DONTNEED); // give pages back, region stays reserved
+        used = 0;
+        for (FreeList& list : free_lists)
+            list.head = nullptr;
+    }
+};
+
+// allocator, that keeps all objects in one contiguous reserved region of address space
+// pages are committed by the OS on first touch, so unused capacity costs nothing
+// needed by CompactLayout, whose 32-bit OffsetPtr links reach only +-8GiB
+// single objects are recycled through intrusive free list, arrays are never reused
+// copies and rebound copies share the same region, so ArenaAllocator<A>(ArenaAllocator<B>(a)) == a
+template <class T, unsigned long capacity = 1ul << 32>
+class ArenaAllocator {
+    typedef ArenaRegion<capacity> Region;
+    typedef typename Region::FreeList FreeList;
+
+    static constexpr std::size_t slot_alignment = std::max(alignof(T), alignof(void*));
+    static constexpr std::size_t slot_size = (std::max(sizeof(T), sizeof(void*)) + slot_alignment - 1)
+                                             / slot_alignment * slot_alignment;
+
+    std::shared_ptr<Region> region = std::make_shared<Region>();
+    FreeList* free_list = nullptr; // slots of Ts, looked up on first use, rebinding doesn't allocate
+
+    FreeList& own_free_list(){
+        if (not free_list)
+            free_list = region->find(slot_size);
+        if (not free_list)
+            free_list = &region->free_lists.emplace_back(slot_size);
+        return *free_list;
+    }
+
+    template <class, unsigned long> friend class ArenaAllocator;
+public:
+    typedef T value_type;
+    typedef std::true_type propagate_on_container_copy_assignment;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    template <class U>
+    struct rebind { typedef ArenaAllocator<U, capacity> other; };
+
+    ArenaAllocator() = default;
+    ArenaAllocator(const ArenaAllocator&) = default; // no move, moved from allocator must stay equal to the new one
+    ArenaAllocator& operator=(const ArenaAllocator&) = default;
+
+    template <class U>
+    ArenaAllocator(const ArenaAllocator<U, capacity>& other) noexcept : region(other.region) {}
+
+    T* allocate(std::size_t n){
+        if (n != 1)
+            return static_cast<T*>(region->allocate(n * sizeof(T), alignof(T)));
+        FreeList& slots = own_free_list();
+        if (slots.head) {
+            void* slot = slots.head;
+            slots.head = *static_cast<void**>(slot);
+            return static_cast<T*>(slot);
+        }
+        return static_cast<T*>(region->allocate(slot_size, slot_alignment));
+    }
+
+    void deallocate(T* pointer, std::size_t n) noexcept {
+        if (n != 1)
+            return;
+        FreeList& slots = own_free_list(); // exists, pointer came from it
+        *reinterpret_cast<void**>(pointer) = slots.head;
+        slots.head = pointer;
+    }
+
+    // forget all objects at once, all of them must be already destroyed
+    // does nothing while some copy still uses the region
+    void release() noexcept {
+        if (region.use_count() == 1)
+            region->release();
+    }
+
+    // bytes taken from the region so far, including recycled slots
+    std::size_t used() const noexcept {
+        return region->used;
+    }
+
+    template <class U>
+    bool operator==(const ArenaAllocator<U, capacity>& other) const noexcept {
+        return region == other.region;
+    }
+
+    template <class U>
+    bool operator!=(const ArenaAllocator<U, capacity>& other) const noexcept {
+        return not (*this == other);
+    }
+};
@@ -0,0 +1,408 @@
+#pragma once
+
+#include <cassert>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// List with the same interface as TreeList, stored as implicit B+tree (rope)
+// leaves hold up to leaf_size contiguous elements and are chained for scans,
+// inner nodes hold up to fanout children together with their element counts
+// lookup touches about log(n / leaf_size) / log(fanout) inner nodes instead of log(n) nodes
+template <class T, unsigned long leaf_size = 128, unsigned long fanout = 32>
+class ChunkList {
+    static_assert(leaf_size >= 2 and fanout >= 4);
+
+    struct Leaf {
+        std::vector<T> items;
+        Leaf *prev = nullptr, *next = nullptr;
+
+        Leaf() { items.reserve(leaf_size); }
+    };
+
+    struct Inner {
+        unsigned long count = 0; // number of children
+        unsigned long sizes[fanout]; // number of elements under each child
+        void* children[fanout]; // Inner* on upper levels, Leaf* right above leaves
+
+        unsigned long total() const noexcept {
+            unsigned long sum = 0;
+            for (unsigned long i = 0; i < count; ++i)
+                sum += sizes[i];
+            return sum;
+        }
+
+        void insert(unsigned long i, void* child, unsigned long size) noexcept {
+            assert(count < fanout);
+            for (unsigned long j = count; j > i; --j){
+                children[j] = children[j - 1];
+                sizes[j] = sizes[j - 1];
+            }
+            children[i] = child;
+            sizes[i] = size;
+            ++count;
+        }
+
+        void erase(unsigned long i) noexcept {
+            for (unsigned long j = i + 1; j < count; ++j){
+                children[j - 1] = children[j];
+                sizes[j - 1] = sizes[j];
+            }
+            --count;
+        }
+
+        // move all children of other to the end
+        void append(Inner* other) noexcept {
+            assert(count + other->count <= fanout);
+            for (unsigned long j = 0; j < other->count; ++j){
+                children[count] = other->children[j];
+                sizes[count++] = other->sizes[j];
+            }
+            other->count = 0;
+        }
+    };
+
+    static constexpr unsigned long max_height = 64;
+
+    void* root = nullptr; // Leaf* when height is 0
+    unsigned long height = 0; // number of inner levels above leaves
+    unsigned long _size = 0;
+    Leaf *first = nullptr, *last = nullptr;
+
+    // path from root to leaf, filled by descend
+    struct Path {
+        Inner* nodes[max_height];
+        unsigned long slots[max_height]; // index of child taken on each level
+    };
+
+    // find leaf containing index, index becomes position inside leaf
+    // for insertion index == size of child is allowed, such element is appended to the child
+    // sizes along path are changed by delta
+    Leaf* descend(unsigned long& index, Path& path, long delta) const noexcept {
+        void* node = root;
+        for (unsigned long level = 0; level < height; ++level){
+            Inner* inner = static_cast<Inner*>(node);
+            unsigned long i = 0;
+            while (i + 1 < inner->count and index >= inner->sizes[i] + (delta > 0)){
+                index -= inner->sizes[i];
+                ++i;
+            }
+            inner->sizes[i] += delta;
+            path.nodes[level] = inner;
+            path.slots[level] = i;
+            node = inner->children[i];
+        }
+        return static_cast<Leaf*>(node);
+    }
+
+    void link_after(Leaf* leaf, Leaf* node) noexcept {
+        node->prev = leaf;
+        node->next = leaf->next;
+        if (leaf->next)
+            leaf->next->prev = node;
+        else
+            last = node;
+        leaf->next = node;
+    }
+
+    void unlink(Leaf* leaf) noexcept {
+        (leaf->prev ? leaf->prev->next : first) = leaf->next;
+        (leaf->next ? leaf->next->prev : last) = leaf->prev;
+        delete leaf;
+    }
+
+    // left was split into left and right, register right in the parents, splitting them if needed
+    void propagate_split(Path& path, void* left, void* right, unsigned long left_size, unsigned long right_size){
+        for (unsigned long level = height; level-- > 0;){
+            Inner* inner = path.nodes[level];
+            unsigned long i = path.slots[level];
+            inner->sizes[i] = left_size;
+            if (inner->count < fanout){
+                inner->insert(i + 1, right, right_size);
+                return;
+            }
+            Inner* sibling = new Inner;
+            unsigned long half = fanout / 2;
+            for (unsigned long j = half; j < inner->count; ++j)
+                sibling->insert(sibling->count, inner->children[j], inner->sizes[j]);
+            inner->count = half;
+            if (i + 1 <= half)
+                inner->insert(i + 1, right, right_size);
+            else
+                sibling->insert(i + 1 - half, right, right_size);
+            left = inner;
+            right = sibling;
+            left_size = inner->total();
+            right_size = sibling->total();
+        }
+        Inner* new_root = new Inner;
+        new_root->insert(0, left, left_size);
+        new_root->insert(1, right, right_size);
+        root = new_root;
+        ++height;
+    }
+
+    // child at path.slots[level] of path.nodes[level] is gone, remove it and merge small inner nodes
+    void drop_child(Path& path, unsigned long level){
+        while (true){
+            Inner* inner = path.nodes[level];
+            inner->erase(path.slots[level]);
+            if (level == 0)
+                break;
+            if (inner->count >= fanout / 4 and inner->count > 0)
+                return;
+            Inner* parent = path.nodes[level - 1];
+            unsigned long j = path.slots[level - 1];
+            if (inner->count == 0){
+                delete inner;
+            } else if (j + 1 < parent->count and
+                       inner->count + static_cast<Inner*>(parent->children[j + 1])->count <= fanout){
+                Inner* next = static_cast<Inner*>(parent->children[j + 1]);
+                inner->append(next);
+                parent->sizes[j] += parent->sizes[j + 1];
+                delete next;
+                path.slots[level - 1] = j + 1;
+            } else if (j > 0 and inner->count + static_cast<Inner*>(parent->children[j - 1])->count <= fanout){
+                static_cast<Inner*>(parent->children[j - 1])->append(inner);
+                parent->sizes[j - 1] += parent->sizes[j];
+                delete inner;
+            } else {
+                return;
+            }
+            --level;
+        }
+        // root with single child is useless
+        while (height > 0 and static_cast<Inner*>(root)->count <= 1){
+            Inner* old = static_cast<Inner*>(root);
+            root = old->count ? old->children[0] : nullptr;
+            height = old->count ? height - 1 : 0;
+            delete old;
+        }
+    }
+
+    void destroy(void* node, unsigned long level) noexcept {
+        if (level == height){
+            delete static_cast<Leaf*>(node);
+            return;
+        }
+        Inner* inner = static_cast<Inner*>(node);
+        for (unsigned long i = 0; i < inner->count; ++i)
+            destroy(inner->children[i], level + 1);
+        delete inner;
+    }
+
+public:
+    ChunkList() = default;
+    ~ChunkList() { clear(); }
+
+    ChunkList(const ChunkList& other) {
+        for (const T& value : other)
+            push_back(value);
+    }
+
+    template <class InputIt, class = typename std::iterator_traits<InputIt>::iterator_category>
+    ChunkList(InputIt first, InputIt last) {
+        for (; first != last; ++first)
+            push_back(*first);
+    }
+
+    ChunkList(ChunkList&& other) noexcept { swap(other); }
+
+    ChunkList& operator=(ChunkList other) noexcept {
+        swap(other);
+        return *this;
+    }
+
+    void swap(ChunkList& other) noexcept {
+        std::swap(root, other.root);
+        std::swap(height, other.height);
+        std::swap(_size, other._size);
+        std::swap(first, other.first);
+        std::swap(last, other.last);
+    }
+
+    void clear() noexcept {
+        if (root)
+            destroy(root, 0);
+        root = nullptr;
+        height = _size = 0;
+        first = last = nullptr;
+    }
+
+    unsigned long size() const noexcept { return _size; }
+    bool empty() const noexcept { return _size == 0; }
+
+    // insert value before index
+    // if index >= number of items, insert after last
+    void insert(unsigned long index, const T& value){
+        T item(value); // copying may throw, so it goes before size and counts on the path change
+        if (index > _size)
+            index = _size;
+        if (not root)
+            root = first = last = new Leaf;
+        ++_size;
+        Path path;
+        Leaf* leaf = descend(index, path, 1);
+        if (leaf->items.size() < leaf_size){
+            leaf->items.insert(leaf->items.begin() + index, std::move(item));
+            return;
+        }
+        Leaf* right = new Leaf;
+        unsigned long half = leaf_size / 2;
+        right->items.assign(std::make_move_iterator(leaf->items.begin() + half),
+                            std::make_move_iterator(leaf->items.end()));
+        leaf->items.resize(half);
+        link_after(leaf, right);
+        if (index <= half)
+            leaf->items.insert(leaf->items.begin() + index, std::move(item));
+        else
+            right->items.insert(right->items.begin() + (index - half), std::move(item));
+        propagate_split(path, leaf, right, leaf->items.size(), right->items.size());
+    }
+
+    void push_back(const T& value){
+        insert(_size, value);
+    }
+
+    // remove value at index
+    // do nothing if no such index
+    void remove(unsigned long index){
+        if (index >= _size)
+            return;
+        --_size;
+        Path path;
+        Leaf* leaf = descend(index, path, -1);
+        leaf->items.erase(leaf->items.begin() + index);
+        if (height == 0){
+            if (leaf->items.empty()){
+                unlink(leaf);
+                root = nullptr;
+            }
+            return;
+        }
+
+        Inner* parent = path.nodes[height - 1];
+        unsigned long& i = path.slots[height - 1];
+        if (leaf->items.empty()){
+            unlink(leaf);
+        } else if (leaf->items.size() >= leaf_size / 4){
+            return;
+        } else if (i + 1 < parent->count and leaf->items.size() + leaf->next->items.size() <= leaf_size){
+            Leaf* next = leaf->next;
+            leaf->items.insert(leaf->items.end(), std::make_move_iterator(next->items.begin()),
+                               std::make_move_iterator(next->items.end()));
+            parent->sizes[i] += parent->sizes[i + 1];
+            unlink(next);
+            ++i;
+        } else if (i > 0 and leaf->items.size() + leaf->prev->items.size() <= leaf_size){
+            Leaf* prev = leaf->prev;
+            prev->items.insert(prev->items.end(), std::make_move_iterator(leaf->items.begin()),
+                               std::make_move_iterator(leaf->items.end()));
+            parent->sizes[i - 1] += parent->sizes[i];
+            unlink(leaf);
+        } else {
+            return;
+        }
+        drop_child(path, height - 1);
+    }
+
+    T& operator[](unsigned long index) {
+        Path path;
+        return descend(index, path, 0)->items[index];
+    }
+
+    const T& operator[](unsigned long index) const {
+        Path path;
+        return descend(index, path, 0)->items[index];
+    }
+
+    T& at(unsigned long index) {
+        if (index >= _size)
+            throw std::out_of_range(std::to_string(index) + " is out of range");
+        return (*this)[index];
+    }
+
+    const T& at(unsigned long index) const {
+        if (index >= _size)
+            throw std::out_of_range(std::to_string(index) + " is out of range");
+        return (*this)[index];
+    }
+
+    // walks through chained leaves, end() is represented by nullptr leaf
+    template <class value_t>
+    class Iterator {
+        friend class ChunkList;
+        template <class> friend class Iterator;
+        Leaf* leaf = nullptr;
+        unsigned long position = 0;
+        const ChunkList* list = nullptr;
+
+        Iterator(Leaf* leaf, unsigned long position, const ChunkList* list)
+            : leaf(leaf), position(position), list(list) {}
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef std::remove_const_t<value_t> value_type;
+        typedef long difference_type;
+        typedef value_t* pointer;
+        typedef value_t& reference;
+
+        Iterator() = default;
+
+        template <class other_t, class = std::enable_if_t<std::is_const_v<value_t> and not std::is_const_v<other_t>>>
+        Iterator(const Iterator<other_t>& other) : leaf(other.leaf), position(other.position), list(other.list) {}
+
+        reference operator*() const { return leaf->items[position]; }
+        pointer operator->() const { return &leaf->items[position]; }
+
+        Iterator& operator++() {
+            if (++position == leaf->items.size()){
+                leaf = leaf->next;
+                position = 0;
+            }
+            return *this;
+        }
+
+        Iterator& operator--() {
+            if (not leaf){
+                leaf = list->last;
+                position = leaf->items.size();
+            } else if (position == 0){
+                leaf = leaf->prev;
+                position = leaf->items.size();
+            }
+            --position;
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator copy = *this;
+            ++*this;
+            return copy;
+        }
+
+        Iterator operator--(int) {
+            Iterator copy = *this;
+            --*this;
+            return copy;
+        }
+
+        template <class other_t>
+        bool operator==(const Iterator<other_t>& other) const noexcept {
+            return leaf == other.leaf and position == other.position;
+        }
+
+        template <class other_t>
+        bool operator!=(const Iterator<other_t>& other) const noexcept {
+            return not (*this == other);
+        }
+    };
+
+    typedef Iterator<T> iterator;
+    typedef Iterator<const T> const_iterator;
+
+    iterator begin() { return iterator(first, 0, this); }
+    iterator end() { return iterator(nullptr, 0, this); }
+    const_iterator begin() const { return const_iterator(first, 0, this); }
+    const_iterator end() const { return const_iterator(nullptr, 0, this); }
+};
@@ -0,0 +1,138 @@
+#pragma once
+
+#include "TreeList.h"
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+// TreeList, that can be used from many threads
+// readers run in parallel under shared lock and get copies, not references, of values
+// writers don't fight for the tree: each one publishes its operation in a lock-free stack,
+// and whoever holds the combiner lock applies all published operations under one exclusive lock,
+// so root and upper levels of the tree stay in one core's cache while a batch is applied
+// every writer returns only after its own operation is applied, so each thread sees its writes in order
+// exception thrown by an operation is rethrown by its own writer, the rest of the batch is applied anyway
+template <class T, class... Policies>
+class ConcurrentTreeList {
+public:
+    typedef TreeList<T, Policies...> List;
+    static_assert(not List::NodeType::lazy and not List::NodeType::reversible,
+                  "lazy updates are pushed down by readers, so shared lock isn't enough");
+    static_assert(std::is_same_v<typename List::StatsType, NoStats>,
+                  "readers count descents at the same time, counters aren't atomic");
+private:
+    struct Operation {
+        enum Kind { insert, remove, push_back, set } kind;
+        unsigned long index;
+        const T* value;
+        Operation* next = nullptr;
+        std::exception_ptr error = nullptr;
+        std::atomic<bool> done{false};
+    };
+
+    List list;
+    mutable std::shared_mutex lock; // readers against the combiner
+    std::mutex combiner;
+    std::atomic<Operation*> pending{nullptr}; // newest first
+
+    void submit(Operation& operation){
+        operation.next = pending.load(std::memory_order_relaxed);
+        while (not pending.compare_exchange_weak(operation.next, &operation, std::memory_order_release,
+                                                 std::memory_order_relaxed));
+        while (not operation.done.load(std::memory_order_acquire)){
+            if (std::unique_lock<std::mutex> guard(combiner, std::try_to_lock); guard.owns_lock())
+                combine();
+            else
+                std::this_thread::yield();
+        }
+        if (operation.error)
+            std::rethrow_exception(operation.error);
+    }
+
+    // apply everything published so far as one batch
+    void combine(){
+        Operation* batch = pending.exchange(nullptr, std::memory_order_acquire);
+        if (not batch)
+            return;
+        Operation* oldest = nullptr; // reverse stack to apply operations in order of arrival
+        while (batch){
+            Operation* next = batch->next;
+            batch->next = oldest;
+            oldest = batch;
+            batch = next;
+        }
+        {
+            std::unique_lock<std::shared_mutex> guard(lock);
+            for (Operation* operation = oldest; operation; operation = operation->next){
+                try {
+                    apply(*operation);
+                } catch (...) { // belongs to the writer of operation, not to the combining one
+                    operation->error = std::current_exception();
+                }
+            }
+        }
+        while (oldest){
+            Operation* next = oldest->next; // operation dies as soon as its writer sees done
+            oldest->done.store(true, std::memory_order_release);
+            oldest = next;
+        }
+    }
+
+    void apply(const Operation& operation){
+        switch (operation.kind){
+            case Operation::insert: list.insert(operation.index, *operation.value); break;
+            case Operation::remove: list.remove(operation.index); break;
+            case Operation::push_back: list.push_back(*operation.value); break;
+            case Operation::set:
+                if (list.get_node(operation.index)) // at() would throw inside the batch
+                    list.set(operation.index, *operation.value);
+                break;
+        }
+    }
+public:
+    ConcurrentTreeList() = default;
+    ConcurrentTreeList(const ConcurrentTreeList&) = delete;
+    ConcurrentTreeList& operator=(const ConcurrentTreeList&) = delete;
+
+    void insert(unsigned long index, const T& value){
+        Operation operation{Operation::insert, index, &value};
+        submit(operation);
+    }
+
+    void remove(unsigned long index){
+        Operation operation{Operation::remove, index, nullptr};
+        submit(operation);
+    }
+
+    void push_back(const T& value){
+        Operation operation{Operation::push_back, 0, &value};
+        submit(operation);
+    }
+
+    // do nothing if no such index
+    void set(unsigned long index, const T& value){
+        Operation operation{Operation::set, index, &value};
+        submit(operation);
+    }
+
+    T at(unsigned long index) const {
+        std::shared_lock<std::shared_mutex> guard(lock);
+        return list.at(index);
+    }
+
+    unsigned long size() const {
+        std::shared_lock<std::shared_mutex> guard(lock);
+        return list.size();
+    }
+
+    // call reader(list) under shared lock, list must not be modified
+    template <class Reader>
+    auto read(Reader reader) const {
+        std::shared_lock<std::shared_mutex> guard(lock);
+        return reader(static_cast<const List&>(list));
+    }
+};
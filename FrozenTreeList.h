@@ -0,0 +1,109 @@
+#pragma once
+
+#include "TreeList.h"
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// immutable read view of a list, made by TreeList::freeze in O(n)
+// elements are in one array, so at() is O(1) and scans run at std::vector speed
+// sorted views can also get search index: copy of elements in Eytzinger (BFS) order,
+// where the path of a binary search goes through 1, 2-3, 4-7, ... and the next levels are prefetched
+// while the current one is compared, so searches don't wait for memory at every step
+// thaw() builds balanced TreeList again in O(n)
+template <class T, class Compare = std::less<T>>
+class FrozenTreeList {
+    std::vector<T> values;
+    std::vector<T> tree; // Eytzinger order, 1-based, empty until build_index()
+    std::vector<unsigned long> positions; // positions[k] is index of tree[k] in values
+    bool indexed = false;
+    [[no_unique_address]] Compare compare;
+
+    // elements per cache line, prefetching tree[k * block] brings the node 4 levels below k
+    static constexpr unsigned long block = sizeof(T) < 64 ? 64 / sizeof(T) : 1;
+
+    // in-order walk of implicit tree fills it with sorted values
+    unsigned long fill(unsigned long i, unsigned long k){
+        if (k < tree.size()){
+            i = fill(i, 2 * k);
+            tree[k] = values[i];
+            positions[k] = i++;
+            i = fill(i, 2 * k + 1);
+        }
+        return i;
+    }
+public:
+    typedef typename std::vector<T>::const_iterator const_iterator;
+
+    FrozenTreeList() = default;
+
+    explicit FrozenTreeList(std::vector<T> values, const Compare& compare = Compare())
+        : values(std::move(values)), compare(compare) {}
+
+    const T& operator[](unsigned long index) const { return values[index]; }
+
+    const T& at(unsigned long index) const {
+        if (index >= values.size())
+            throw std::out_of_range(std::to_string(index) + " is out of range");
+        return values[index];
+    }
+
+    unsigned long size() const noexcept { return values.size(); }
+    bool empty() const noexcept { return values.empty(); }
+    const T* data() const noexcept { return values.data(); }
+
+    const_iterator begin() const { return values.begin(); }
+    const_iterator end() const { return values.end(); }
+
+    // prepare lower_bound, elements must be sorted by Compare, O(n)
+    void build_index(){
+        assert(std::is_sorted(values.begin(), values.end(), compare));
+        if (not values.empty()){
+            tree.assign(values.size() + 1, values.front()); // tree[0] is never used
+            positions.assign(values.size() + 1, 0);
+            fill(0, 1);
+        }
+        indexed = true;
+    }
+
+    bool has_index() const noexcept { return indexed; }
+
+    // index of first element not less than value, size() if there is none, O(log n)
+    unsigned long lower_bound(const T& value) const {
+        assert(has_index());
+        unsigned long n = tree.size(), k = 1;
+        while (k < n){
+            __builtin_prefetch(tree.data() + std::min(k * block, n - 1));
+            k = 2 * k + compare(tree[k], value); // go right while tree[k] < value
+        }
+        k >>= __builtin_ffsl(~k); // undo right turns and the last left one, which found the answer
+        return k ? positions[k] : values.size();
+    }
+
+    // index of first element greater than value
+    unsigned long upper_bound(const T& value) const {
+        assert(has_index());
+        unsigned long n = tree.size(), k = 1;
+        while (k < n){
+            __builtin_prefetch(tree.data() + std::min(k * block, n - 1));
+            k = 2 * k + not compare(value, tree[k]);
+        }
+        k >>= __builtin_ffsl(~k);
+        return k ? positions[k] : values.size();
+    }
+
+    bool contains(const T& value) const {
+        unsigned long index = lower_bound(value);
+        return index < values.size() and not compare(value, values[index]);
+    }
+
+    // editable list with the same elements, balanced tree is built directly in O(n)
+    template <class List = TreeList<T>>
+    List thaw() const {
+        return List(values.begin(), values.end());
+    }
+};
@@ -0,0 +1,220 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <cerrno>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <typeinfo>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// first bytes of arena, objects follow it
+// all positions are offsets from the beginning of the arena, so they survive remapping at other address
+struct MappedArenaHeader {
+    char magic[8] = {'T', 'L', 'A', 'r', 'e', 'n', 'a', '\0'};
+    std::uint32_t version = 2;
+    std::uint32_t slot_size = 0;
+    std::uint32_t slot_alignment = 0;
+    std::uint64_t type_tag = 0; // with slot size and alignment catches opening the file with other node type
+    std::uint64_t used = sizeof(MappedArenaHeader); // bytes, header included
+    std::uint64_t free = 0; // first recycled slot, 0 is none
+    std::uint64_t root = 0; // object, that owner of the arena needs to find after reopening, 0 is none
+    std::uint64_t count = 0; // owner's number, e.g. size of list
+
+    // FNV-1a of type's mangled name, unlike typeid::hash_code it is the same in every run and every build
+    // with the same ABI, so the file can be reopened by other programs with the same node type
+    template <class T>
+    static std::uint64_t tag() noexcept {
+        std::uint64_t hash = 14695981039346656037ull;
+        for (const char* c = typeid(T).name(); *c; ++c)
+            hash = (hash ^ static_cast<unsigned char>(*c)) * 1099511628211ull;
+        return hash;
+    }
+};
+
+// ArenaAllocator, whose arena can be a file mapped with MAP_SHARED
+// objects are written straight to the page cache, reopening the file gives them back at once,
+// possibly at other address, so objects must not contain raw pointers: use CompactLayout, whose links are relative
+// default constructed allocator works on anonymous memory, like ArenaAllocator
+// file grows as the arena is used and is trimmed to used size when the last copy is destroyed
+// one process at a time may modify the file
+template <class T, unsigned long capacity = 1ul << 32>
+class MappedAllocator {
+    union Slot {
+        std::uint64_t next; // offset of next slot, valid while slot is in free list
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    struct Arena {
+        char* begin;
+        int file = -1;
+        std::size_t file_size = 0;
+        MappedArenaHeader* header;
+
+        Arena() {
+            void* memory = mmap(nullptr, capacity, PROT_READ | PROT_WRITE,
+                                MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            if (memory == MAP_FAILED)
+                throw std::bad_alloc();
+            begin = static_cast<char*>(memory);
+            header = new (begin) MappedArenaHeader(expected());
+        }
+
+        static MappedArenaHeader expected() noexcept {
+            MappedArenaHeader header;
+            header.slot_size = sizeof(Slot);
+            header.slot_alignment = alignof(Slot);
+            header.type_tag = MappedArenaHeader::tag<T>();
+            return header;
+        }
+
+        explicit Arena(const char* path) {
+            file = open(path, O_RDWR | O_CREAT, 0644);
+            if (file < 0)
+                throw std::system_error(errno, std::generic_category(), std::string("can't open ") + path);
+            struct stat status;
+            if (fstat(file, &status) != 0) {
+                int error = errno;
+                close(file);
+                throw std::system_error(error, std::generic_category(), std::string("can't stat ") + path);
+            }
+            file_size = status.st_size;
+            void* memory = file_size <= capacity ? mmap(nullptr, capacity, PROT_READ | PROT_WRITE,
+                                                        MAP_SHARED | MAP_NORESERVE, file, 0) : MAP_FAILED;
+            if (memory == MAP_FAILED) {
+                int error = file_size <= capacity ? errno : EFBIG;
+                close(file);
+                throw std::system_error(error, std::generic_category(), std::string("can't map ") + path);
+            }
+            begin = static_cast<char*>(memory);
+            if (file_size == 0) {
+                grow(sizeof(MappedArenaHeader));
+                header = new (begin) MappedArenaHeader(expected());
+                return;
+            }
+            header = reinterpret_cast<MappedArenaHeader*>(begin);
+            MappedArenaHeader expected = Arena::expected();
+            if (file_size < sizeof(MappedArenaHeader) or
+                not std::equal(header->magic, header->magic + 8, expected.magic) or
+                header->version != expected.version or header->slot_size != expected.slot_size or
+                header->slot_alignment != expected.slot_alignment or header->type_tag != expected.type_tag or
+                header->used > file_size) {
+                munmap(begin, capacity);
+                close(file);
+                throw std::runtime_error(std::string(path) + " is not an arena of this type");
+            }
+        }
+
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+
+        ~Arena() {
+            if (file >= 0) {
+                msync(begin, header->used, MS_SYNC);
+                std::size_t used = header->used;
+                munmap(begin, capacity);
+                ftruncate(file, used); // give back space reserved for growth
+                close(file);
+            } else
+                munmap(begin, capacity);
+        }
+
+        // make sure first size bytes are backed by the file, touching pages past its end is SIGBUS
+        void grow(std::size_t size){
+            if (file < 0 or size <= file_size)
+                return;
+            std::size_t new_size = std::min<std::size_t>(capacity, std::max<std::size_t>(size, file_size * 2 + 4096));
+            if (ftruncate(file, new_size) != 0)
+                throw std::bad_alloc();
+            file_size = new_size;
+        }
+
+        void* allocate(std::size_t bytes){
+            bytes = (bytes + alignof(Slot) - 1) / alignof(Slot) * alignof(Slot);
+            std::size_t start = (header->used + alignof(Slot) - 1) / alignof(Slot) * alignof(Slot);
+            if (start + bytes > capacity)
+                throw std::bad_alloc();
+            grow(start + bytes);
+            header->used = start + bytes;
+            return begin + start;
+        }
+    };
+
+    std::shared_ptr<Arena> arena;
+
+    template <class, unsigned long> friend class MappedAllocator;
+public:
+    typedef T value_type;
+    typedef std::true_type propagate_on_container_copy_assignment;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    template <class U>
+    struct rebind { typedef MappedAllocator<U, capacity> other; };
+
+    MappedAllocator() : arena(std::make_shared<Arena>()) {}
+
+    // creates the file if it doesn't exist, throws std::system_error if it can't be opened or mapped
+    // and std::runtime_error if it isn't an arena of Ts
+    explicit MappedAllocator(const char* path) : arena(std::make_shared<Arena>(path)) {}
+
+    template <class U>
+    MappedAllocator(const MappedAllocator<U, capacity>& other) : arena(other.arena) {}
+
+    T* allocate(std::size_t n){
+        if (n == 1 and arena->header->free) {
+            Slot* slot = reinterpret_cast<Slot*>(arena->begin + arena->header->free);
+            arena->header->free = slot->next;
+            return reinterpret_cast<T*>(slot);
+        }
+        return static_cast<T*>(arena->allocate(n == 1 ? sizeof(Slot) : n * sizeof(T)));
+    }
+
+    void deallocate(T* pointer, std::size_t n) noexcept {
+        if (n != 1)
+            return;
+        Slot* slot = reinterpret_cast<Slot*>(pointer);
+        slot->next = arena->header->free;
+        arena->header->free = offset(pointer);
+    }
+
+    MappedArenaHeader& header() const noexcept { return *arena->header; }
+
+    // position of object inside the arena, stays the same after reopening
+    std::uint64_t offset(const void* pointer) const noexcept {
+        return pointer ? static_cast<const char*>(pointer) - arena->begin : 0;
+    }
+
+    template <class U = T>
+    U* address(std::uint64_t offset) const noexcept {
+        return offset ? reinterpret_cast<U*>(arena->begin + offset) : nullptr;
+    }
+
+    // write dirty pages to the file, arena is written anyway when the last copy is destroyed
+    void sync() const {
+        if (arena->file >= 0)
+            msync(arena->begin, arena->header->used, MS_SYNC);
+    }
+
+    // bytes taken from the arena so far, including header and recycled slots
+    std::size_t used() const noexcept {
+        return arena->header->used;
+    }
+
+    template <class U>
+    bool operator==(const MappedAllocator<U, capacity>& other) const noexcept {
+        return static_cast<const void*>(arena.get()) == static_cast<const void*>(other.arena.get());
+    }
+
+    template <class U>
+    bool operator!=(const MappedAllocator<U, capacity>& other) const noexcept {
+        return not (*this == other);
+    }
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "TreeList.h"
+#include "MappedAllocator.h"
+#include <type_traits>
+
+// TreeList, whose nodes live in a file, see MappedAllocator
+// opening an existing file is O(1): root and size are read from the arena header,
+// nodes are linked by CompactLayout's relative offsets, so the tree is usable wherever the file is mapped,
+// and the same rotations and fix work on it unchanged
+// root and size are written back by sync() and by the destructor, nodes themselves are always in the file
+// don't swap with or concat lists from other arenas, their nodes can't be linked with offsets
+template <class T, class Augment = NoAugment, unsigned long capacity = 1ul << 32>
+class MappedTreeList : public TreeList<T, MappedAllocator<T, capacity>, CompactLayout, Augment> {
+    typedef TreeList<T, MappedAllocator<T, capacity>, CompactLayout, Augment> List;
+    static_assert(std::is_trivially_copyable_v<T>, "values are stored in the file as they are, so they can't own memory");
+public:
+    // creates empty list if the file doesn't exist
+    explicit MappedTreeList(const char* path) {
+        this->_allocator = typename List::node_allocator(path);
+        MappedArenaHeader& header = this->_allocator.header();
+        this->root = this->_allocator.address(header.root);
+        this->_size = header.count;
+        this->find_ends();
+    }
+
+    ~MappedTreeList() {
+        sync();
+        this->root = nullptr; // nodes stay in the file
+        this->_size = 0;
+    }
+
+    MappedTreeList(const MappedTreeList&) = delete;
+    MappedTreeList& operator=(const MappedTreeList&) = delete;
+
+    void sync() {
+        MappedArenaHeader& header = this->_allocator.header();
+        header.root = this->_allocator.offset(this->root);
+        header.count = this->_size;
+        this->_allocator.sync();
+    }
+};
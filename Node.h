@@ -3,15 +3,31 @@
 #include <cmath>
 #include <algorithm>
 #include <cassert>
+#include <type_traits>
+#include <utility>
+#include "NodeLayout.h"
+#include "NodeAugment.h"
+
+// Layout chooses types of links, diff and height, see NodeLayout.h
+// Augment chooses aggregate, that every node keeps for its subtree, see NodeAugment.h
+// and lazy updates: node's own value and aggregate are always up to date,
+// pending tag and reversal belong to its children and are pushed to them before descending
+template <class T, class Layout = PointerLayout, class Augment = NoAugment>
+struct Node : AugmentStorage<Augment> {
+    typedef T value_type;
+    typedef typename Layout::template link<Node> link;
+    static constexpr bool augmented = has_aggregate<Augment>::value;
+    static constexpr bool lazy = has_tag<Augment>::value;
+    static constexpr bool reversible = is_reversible<Augment>::value;
 
-template <class T>
-struct Node{
     T value;
-    long diff=0;
-    unsigned long height=1; // maximum height
-    Node *right= nullptr, *left = nullptr, *parent= nullptr;
+    typename Layout::diff_type diff=0;
+    link right= nullptr, left = nullptr, parent= nullptr;
+    typename Layout::height_type height=1; // maximum height
 
-    Node(long diff, const T& value) : diff(diff), value(value) {} // TODO T& and T&&
+    // value is constructed from args
+    template <class... Args>
+    explicit Node(long diff, Args&&... args) : value(std::forward<Args>(args)...), diff(diff) { pull(); }
 
     bool operator==(const Node &other) const noexcept {
         return value == other.value and diff == other.diff and left == other.left and right == other.right and
@@ -32,8 +48,12 @@ struct Node{
 
     unsigned long index() const noexcept {
         long s = diff;
-        for (Node* current = parent; current; current = current->parent)
+        for (Node* current = parent; current; current = current->parent) {
+            if constexpr (reversible)
+                if (current->reversed) // offsets below current are still mirrored
+                    s = -s;
             s += current->diff;
+        }
         assert(s >= 0);
         return static_cast<unsigned long>(s);
     }
@@ -75,7 +95,7 @@ struct Node{
             node->parent = parent;
     }
 
-    void make_right(Node<T>* node){
+    void make_right(Node* node){
         assert(not right);
         right = node;
         right->parent = this;
@@ -83,7 +103,7 @@ struct Node{
             height = 2;
     }
 
-    void make_left(Node<T>* node){
+    void make_left(Node* node){
         assert(not left);
         left = node;
         left->parent = this;
@@ -101,9 +121,11 @@ struct Node{
     */
     void left_rotate() noexcept {
         assert(right != nullptr);
+        push();
+        right->push();
         // dealing with heights
         height = 1 + std::max(left_height(), right->left_height());
-        right->height = 1 + std::max(height, right->right_height());
+        right->height = 1 + std::max<unsigned long>(height, right->right_height());
         // deal with relative offsets
         long old_diff = diff, old_rdiff = right->diff;
         right->diff += old_diff; // moving up, including new offset component
@@ -118,6 +140,9 @@ struct Node{
 
         right = rl;
         if (rl) rl->parent = this;
+
+        pull();
+        parent->pull();
     }
 
     /*
@@ -130,9 +155,11 @@ struct Node{
     */
     void right_rotate() noexcept {
         assert(left != nullptr);
+        push();
+        left->push();
         // dealing with heights
         height = 1 + std::max(right_height(), left->right_height());
-        left->height = 1 + std::max(height, left->left_height());
+        left->height = 1 + std::max<unsigned long>(height, left->left_height());
         // deal with relative offsets
         long old_diff = diff, old_ldiff = left->diff;
         left->diff += old_diff; // moving up, including new offset component
@@ -147,21 +174,143 @@ struct Node{
 
         left = lr; // get left's right child
         if (lr) lr->parent = this;
+
+        pull();
+        parent->pull();
     }
 
     // return min node, larger then current
-    Node* successor() const noexcept {
+    Node* successor() noexcept {
         assert(right);
-        Node* current = right;
-        long current_diff = current->diff;
+        push();
+        return right->min();
+    }
+
+    void fix_height() noexcept {
+        height = proper_height();
+    }
+
+    // give pending tag and reversal to children
+    void push() noexcept {
+        if constexpr (lazy)
+            if (this->tagged) {
+                if (left) left->apply(this->tag);
+                if (right) right->apply(this->tag);
+                this->tagged = false;
+            }
+        if constexpr (reversible)
+            if (this->reversed) {
+                Node* old_left = left; // not std::swap, temporary OffsetPtr can't point from stack
+                left = right;
+                right = old_left;
+                if (left) { left->diff = -left->diff; left->reverse(); }
+                if (right) { right->diff = -right->diff; right->reverse(); }
+                this->reversed = false;
+            }
+    }
+
+    // update value and aggregate now, children later
+    template <class Tag>
+    void apply(const Tag& tag) noexcept {
+        Augment::apply(tag, value);
+        if constexpr (augmented)
+            Augment::apply(tag, this->aggregate);
+        this->tag = this->tagged ? Augment::compose(tag, this->tag) : tag;
+        this->tagged = true;
+    }
+
+    // mirror subtree, diff of this has to be changed by caller
+    void reverse() noexcept {
+        if constexpr (has_reverse<Augment>::value)
+            Augment::reverse(this->aggregate);
+        this->reversed = not this->reversed;
+    }
+
+    // recalculate aggregate from children, they must be correct
+    void pull() noexcept {
+        if constexpr (augmented) {
+            auto aggregate = Augment::lift(value);
+            if (left)
+                aggregate = Augment::combine(left->aggregate, aggregate);
+            if (right)
+                aggregate = Augment::combine(aggregate, right->aggregate);
+            this->aggregate = aggregate;
+        }
+    }
+
+    // recalculate aggregates on the way to root
+    void pull_path() noexcept {
+        if constexpr (augmented)
+            for (Node* current = this; current; current = current->parent)
+                current->pull();
+    }
+
+    // leftmost node of subtree
+    Node* min() noexcept {
+        Node* current = this;
+        current->push();
         while (current->left) {
             current = current->left;
-            current_diff += current->diff;
+            current->push();
         }
         return current;
     }
 
-    void fix_height() noexcept {
-        height = proper_height();
+    // rightmost node of subtree
+    Node* max() noexcept {
+        Node* current = this;
+        current->push();
+        while (current->right) {
+            current = current->right;
+            current->push();
+        }
+        return current;
+    }
+
+    // next node in order, nullptr if this is last
+    Node* next() noexcept {
+        push();
+        if (right)
+            return right->min();
+        Node* current = this;
+        while (current->is_right())
+            current = current->parent;
+        return current->parent;
+    }
+
+    // previous node in order, nullptr if this is first
+    Node* prev() noexcept {
+        push();
+        if (left)
+            return left->max();
+        Node* current = this;
+        while (current->is_left())
+            current = current->parent;
+        return current->parent;
+    }
+
+    // node which index is this->index() + offset, nullptr if not exist
+    // climbs only until target is known to be inside current subtree, then descends
+    Node* relative(long offset) noexcept {
+        Node* current = this;
+        long current_offset = 0; // index of current relative to this
+        while (offset != 0 and current->parent){
+            long parent_offset = current_offset - current->diff;
+            // coming from the left means parent's left subtree contains [this, parent)
+            bool found = offset > 0 ? current->is_left() and parent_offset >= offset
+                                    : current->is_right() and parent_offset <= offset;
+            current = current->parent;
+            current_offset = parent_offset;
+            if (found)
+                break;
+        }
+        while (current_offset != offset){
+            current->push();
+            current = offset < current_offset ? current->left : current->right;
+            if (not current)
+                return nullptr;
+            current_offset += current->diff;
+        }
+        return current;
     }
 };
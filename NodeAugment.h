@@ -0,0 +1,159 @@
+#pragma once
+
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+
+// Augment keeps aggregate of every subtree in its root node, so TreeList::reduce works in O(log n)
+// any monoid can be used:
+// struct MyAugment {
+//     typedef ... value_type; // aggregate
+//     static value_type identity();
+//     static value_type lift(const T& element);
+//     static value_type combine(const value_type& left, const value_type& right); // associative
+// };
+// lazy range updates (TreeList::apply) need tag, that describes update:
+//     typedef ... tag_type;
+//     static tag_type compose(const tag_type& newer, const tag_type& older);
+//     static void apply(const tag_type& tag, T& element);
+//     static void apply(const tag_type& tag, value_type& aggregate); // if there is aggregate
+// lazy reversal (TreeList::reverse) needs
+//     static constexpr bool reversible = true;
+//     static void reverse(value_type& aggregate); // only if aggregate depends on order
+// aggregate can be used without tags and tags without aggregate
+
+// no aggregate, nodes don't store anything extra
+struct NoAugment {};
+
+template <class T>
+struct SumAugment {
+    typedef T value_type;
+    static value_type identity() { return T(); }
+    static value_type lift(const T& element) { return element; }
+    static value_type combine(const value_type& left, const value_type& right) { return left + right; }
+};
+
+template <class T>
+struct MinAugment {
+    typedef T value_type;
+    static value_type identity() { return std::numeric_limits<T>::max(); }
+    static value_type lift(const T& element) { return element; }
+    static value_type combine(const value_type& left, const value_type& right) { return std::min(left, right); }
+};
+
+template <class T>
+struct MaxAugment {
+    typedef T value_type;
+    static value_type identity() { return std::numeric_limits<T>::lowest(); }
+    static value_type lift(const T& element) { return element; }
+    static value_type combine(const value_type& left, const value_type& right) { return std::max(left, right); }
+};
+
+// only reversal
+struct ReverseAugment {
+    static constexpr bool reversible = true;
+};
+
+// sum with range add and range assign, aggregate knows number of elements to add tag to all of them
+// plain T is an add tag, so list.apply(first, last, 5) adds 5, AddSumAugment<T>::assign(5) sets elements to 5
+template <class T>
+struct AddSumAugment {
+    struct value_type {
+        T sum = T();
+        unsigned long count = 0;
+        bool operator==(const value_type& other) const { return sum == other.sum and count == other.count; }
+    };
+    static value_type identity() { return {}; }
+    static value_type lift(const T& element) { return {element, 1}; }
+    static value_type combine(const value_type& left, const value_type& right) {
+        return {left.sum + right.sum, left.count + right.count};
+    }
+
+    struct tag_type {
+        T value = T(); // added to elements, or given to them if assigned
+        bool assigned = false;
+        tag_type() = default;
+        tag_type(const T& delta) : value(delta) {}
+    };
+    static tag_type assign(const T& value) {
+        tag_type tag(value);
+        tag.assigned = true;
+        return tag;
+    }
+    // assignment discards everything before it, additions after it change assigned value
+    static tag_type compose(const tag_type& newer, const tag_type& older) {
+        if (newer.assigned)
+            return newer;
+        tag_type result = older;
+        result.value += newer.value;
+        return result;
+    }
+    static void apply(const tag_type& tag, T& element) {
+        if (tag.assigned)
+            element = tag.value;
+        else
+            element += tag.value;
+    }
+    static void apply(const tag_type& tag, value_type& aggregate) {
+        if (tag.assigned)
+            aggregate.sum = tag.value * T(aggregate.count);
+        else
+            aggregate.sum += tag.value * T(aggregate.count);
+    }
+
+    static constexpr bool reversible = true; // sum doesn't depend on order
+};
+
+template <class Augment, class = void>
+struct has_aggregate : std::false_type {};
+
+template <class Augment>
+struct has_aggregate<Augment, std::void_t<typename Augment::value_type>> : std::true_type {};
+
+template <class Augment, class = void>
+struct has_tag : std::false_type {};
+
+template <class Augment>
+struct has_tag<Augment, std::void_t<typename Augment::tag_type>> : std::true_type {};
+
+template <class Augment, class = void>
+struct is_reversible : std::false_type {};
+
+template <class Augment>
+struct is_reversible<Augment, std::enable_if_t<Augment::reversible>> : std::true_type {};
+
+template <class Augment, class = void>
+struct has_reverse : std::false_type {};
+
+template <class Augment>
+struct has_reverse<Augment, std::void_t<decltype(Augment::reverse(std::declval<typename Augment::value_type&>()))>>
+    : std::true_type {};
+
+// storage of aggregate, tag and reversal flag inside a node, each is empty when not needed
+template <class Augment, bool = has_aggregate<Augment>::value>
+struct AggregateStorage {
+    typename Augment::value_type aggregate = Augment::identity();
+};
+
+template <class Augment>
+struct AggregateStorage<Augment, false> {};
+
+template <class Augment, bool = has_tag<Augment>::value>
+struct TagStorage {
+    typename Augment::tag_type tag{};
+    bool tagged = false; // tag has to be pushed to children
+};
+
+template <class Augment>
+struct TagStorage<Augment, false> {};
+
+template <bool reversible>
+struct ReverseStorage {
+    bool reversed = false; // children have to be swapped
+};
+
+template <>
+struct ReverseStorage<false> {};
+
+template <class Augment>
+struct AugmentStorage : AggregateStorage<Augment>, TagStorage<Augment>, ReverseStorage<is_reversible<Augment>::value> {};
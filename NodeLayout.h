@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <cstddef>
+
+// 32-bit pointer, that stores distance from itself to pointee
+// works as long as pointee lies within +-8GiB, e.g. both are in the same ArenaAllocator
+// distance doesn't depend on where memory is mapped
+template <class T>
+class OffsetPtr {
+    static constexpr std::ptrdiff_t unit = alignof(std::int32_t); // pointee and pointer both aligned at least this
+    std::int32_t offset = 0; // 0 is nullptr, because pointer never points to itself
+
+    void set(T* pointer) noexcept {
+        if (not pointer) {
+            offset = 0;
+            return;
+        }
+        std::ptrdiff_t distance = reinterpret_cast<const char*>(pointer) - reinterpret_cast<const char*>(this);
+        assert(distance % unit == 0);
+        assert(distance / unit >= INT32_MIN and distance / unit <= INT32_MAX);
+        offset = static_cast<std::int32_t>(distance / unit);
+    }
+public:
+    OffsetPtr() = default;
+    OffsetPtr(T* pointer) noexcept { set(pointer); }
+    OffsetPtr(std::nullptr_t) noexcept {}
+    OffsetPtr(const OffsetPtr& other) noexcept { set(other.get()); } // distance is relative, can't copy it
+
+    OffsetPtr& operator=(const OffsetPtr& other) noexcept {
+        set(other.get());
+        return *this;
+    }
+
+    OffsetPtr& operator=(T* pointer) noexcept {
+        set(pointer);
+        return *this;
+    }
+
+    T* get() const noexcept {
+        if (offset == 0)
+            return nullptr;
+        return reinterpret_cast<T*>(const_cast<char*>(reinterpret_cast<const char*>(this)) + offset * unit);
+    }
+
+    operator T*() const noexcept { return get(); }
+    T* operator->() const noexcept { return get(); }
+    T& operator*() const noexcept { return *get(); }
+};
+
+// regular pointers and machine words
+struct PointerLayout {
+    template <class Node>
+    using link = Node*;
+    typedef long diff_type;
+    typedef unsigned long height_type;
+};
+
+// 32-bit links and diffs, 8-bit height. Avl height never exceeds ~1.44 * log2(size), so 8 bit is enough.
+// Limits list to 2^31 elements and requires all nodes to be within +-8GiB of each other, use ArenaAllocator
+struct CompactLayout {
+    template <class Node>
+    using link = OffsetPtr<Node>;
+    typedef std::int32_t diff_type;
+    typedef std::uint8_t height_type;
+};
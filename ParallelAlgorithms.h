@@ -0,0 +1,254 @@
+#pragma once
+
+#include "TreeList.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// fork-join pool with work stealing
+// every worker has its own deque: it pushes and pops forked tasks at the back,
+// idle workers steal the oldest, therefore largest, tasks from the front of other deques
+// waiting for forked task means running other tasks meanwhile, so workers never block on each other
+// idle workers sleep until a task is queued, exceptions of tasks are rethrown by fork_join
+class ThreadPool {
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues; // last one is shared by threads outside of the pool
+    std::vector<std::thread> threads;
+    std::atomic<bool> stop{false};
+    std::atomic<unsigned long> queued{0}; // tasks in all queues, raised under sleep_mutex so no wake up is lost
+    std::mutex sleep_mutex;
+    std::condition_variable wake;
+
+    static unsigned long& worker_index() {
+        static thread_local unsigned long index = -1;
+        return index;
+    }
+
+    Queue& own_queue() {
+        unsigned long index = std::min(worker_index(), queues.size() - 1); // threads is still filled at start
+        return *queues[index];
+    }
+
+    void push(std::function<void()> task) {
+        Queue& queue = own_queue();
+        {
+            std::lock_guard<std::mutex> guard(queue.mutex);
+            queue.tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard<std::mutex> guard(sleep_mutex);
+            ++queued;
+        }
+        wake.notify_one();
+    }
+
+    // run one task, own newest or someone's oldest, false if there is nothing to do
+    bool run_one() {
+        std::function<void()> task;
+        Queue& own = own_queue();
+        {
+            std::lock_guard<std::mutex> guard(own.mutex);
+            if (not own.tasks.empty()) {
+                task = std::move(own.tasks.back());
+                own.tasks.pop_back();
+                --queued;
+            }
+        }
+        for (unsigned long i = 0; not task and i < queues.size(); ++i) {
+            Queue& victim = *queues[i];
+            std::lock_guard<std::mutex> guard(victim.mutex);
+            if (not victim.tasks.empty()) {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                --queued;
+            }
+        }
+        if (not task)
+            return false;
+        task();
+        return true;
+    }
+
+    void work(unsigned long index) {
+        worker_index() = index;
+        while (not stop) {
+            if (run_one())
+                continue;
+            std::unique_lock<std::mutex> lock(sleep_mutex);
+            wake.wait(lock, [&]{ return stop or queued > 0; });
+        }
+    }
+public:
+    explicit ThreadPool(unsigned long count = std::max(1u, std::thread::hardware_concurrency())) {
+        for (unsigned long i = 0; i <= count; ++i)
+            queues.push_back(std::make_unique<Queue>());
+        for (unsigned long i = 0; i < count; ++i)
+            threads.emplace_back(&ThreadPool::work, this, i);
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> guard(sleep_mutex);
+            stop = true;
+        }
+        wake.notify_all();
+        for (std::thread& thread : threads)
+            thread.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned long size() const noexcept { return queues.size() - 1; }
+
+    // run first and second, possibly in parallel, return when both are done
+    // if any of them throws, the exception is rethrown after both are done, the forked task references this frame
+    template <class First, class Second>
+    void fork_join(First first, Second second) {
+        std::atomic<bool> done{false};
+        std::exception_ptr first_error, second_error;
+        push([&]{
+            try {
+                first();
+            } catch (...) {
+                first_error = std::current_exception();
+            }
+            done.store(true, std::memory_order_release);
+        });
+        try {
+            second();
+        } catch (...) {
+            second_error = std::current_exception();
+        }
+        while (not done.load(std::memory_order_acquire))
+            if (not run_one())
+                std::this_thread::yield();
+        if (first_error)
+            std::rethrow_exception(first_error);
+        if (second_error)
+            std::rethrow_exception(second_error);
+    }
+
+    static ThreadPool& shared() {
+        static ThreadPool pool;
+        return pool;
+    }
+};
+
+// subtrees smaller than this are processed serially by one thread
+constexpr unsigned long parallel_cutoff = 4096;
+
+// parallel algorithms over TreeList, work is split at subtree boundaries
+// subtree of node at index covers [begin, end), so sizes of parts are known without counting
+// each node is visited by exactly one thread, which pushes lazy updates to its children first
+template <class List>
+class TreeListAlgorithms {
+    typedef typename List::NodePtr NodePtr;
+
+    // visit(node) for every node of subtree in order, after_children(node) when both subtrees are done
+    template <class Visit, class AfterChildren>
+    static void walk(ThreadPool& pool, NodePtr node, unsigned long index, unsigned long begin, unsigned long end,
+                     Visit& visit, AfterChildren& after_children) {
+        if (not node)
+            return;
+        node->push();
+        auto left = [&]{
+            if (node->left)
+                walk(pool, node->left, index + node->left->diff, begin, index, visit, after_children);
+        };
+        auto rest = [&]{
+            visit(node);
+            if (node->right)
+                walk(pool, node->right, index + node->right->diff, index + 1, end, visit, after_children);
+        };
+        if (end - begin < parallel_cutoff) {
+            left();
+            rest();
+        } else
+            pool.fork_join(left, rest);
+        after_children(node);
+    }
+
+    // combine(result of left subtree, lift(node), result of right subtree) for every node
+    template <class R, class Lift, class Combine>
+    static R fold(ThreadPool& pool, NodePtr node, unsigned long index, unsigned long begin, unsigned long end,
+                  const R& identity, Lift& lift, Combine& combine) {
+        if (not node)
+            return identity;
+        node->push();
+        R left = identity, right = identity;
+        auto fold_left = [&]{
+            if (node->left)
+                left = fold(pool, node->left, index + node->left->diff, begin, index, identity, lift, combine);
+        };
+        auto fold_right = [&]{
+            if (node->right)
+                right = fold(pool, node->right, index + node->right->diff, index + 1, end, identity, lift, combine);
+        };
+        if (end - begin < parallel_cutoff) {
+            fold_left();
+            fold_right();
+        } else
+            pool.fork_join(fold_left, fold_right);
+        return combine(combine(left, lift(node->value)), right);
+    }
+public:
+    template <class Visit, class AfterChildren>
+    static void walk(ThreadPool& pool, const List& list, Visit visit, AfterChildren after_children) {
+        if (list.root)
+            walk(pool, list.root, list.root->diff, 0, list.size(), visit, after_children);
+    }
+
+    template <class R, class Lift, class Combine>
+    static R fold(ThreadPool& pool, const List& list, const R& identity, Lift lift, Combine combine) {
+        if (not list.root)
+            return identity;
+        return fold(pool, list.root, list.root->diff, 0, list.size(), identity, lift, combine);
+    }
+};
+
+// call function(value) for every element, order of calls is unspecified
+// function may change values, but aggregates are not updated, use parallel_transform for that
+template <class T, class... Policies, class Function>
+void parallel_for_each(TreeList<T, Policies...>& list, Function function, ThreadPool& pool = ThreadPool::shared()) {
+    typedef TreeList<T, Policies...> List;
+    static_assert(not List::IndexType::enabled, "index would keep old values");
+    TreeListAlgorithms<List>::walk(pool, list, [&](typename List::NodePtr node){ function(node->value); },
+                                   [](typename List::NodePtr){});
+}
+
+// replace every element with function(element), aggregates are recalculated bottom-up
+template <class T, class... Policies, class Function>
+void parallel_transform(TreeList<T, Policies...>& list, Function function, ThreadPool& pool = ThreadPool::shared()) {
+    typedef TreeList<T, Policies...> List;
+    static_assert(not List::IndexType::enabled, "index would keep old values, set elements one by one");
+    TreeListAlgorithms<List>::walk(pool, list, [&](typename List::NodePtr node){ node->value = function(node->value); },
+                                   [](typename List::NodePtr node){ node->pull(); });
+}
+
+// combine all elements in order, combine must be associative and identity its neutral element
+template <class T, class... Policies, class R, class Combine>
+R parallel_reduce(const TreeList<T, Policies...>& list, const R& identity, Combine combine,
+                  ThreadPool& pool = ThreadPool::shared()) {
+    return TreeListAlgorithms<TreeList<T, Policies...>>::fold(pool, list, identity,
+                                                               [](const T& value) -> R { return value; }, combine);
+}
+
+template <class T, class... Policies, class Predicate>
+unsigned long parallel_count_if(const TreeList<T, Policies...>& list, Predicate predicate,
+                                ThreadPool& pool = ThreadPool::shared()) {
+    return TreeListAlgorithms<TreeList<T, Policies...>>::fold(
+        pool, list, 0ul, [&](const T& value) -> unsigned long { return predicate(value) ? 1 : 0; },
+        [](unsigned long a, unsigned long b) { return a + b; });
+}
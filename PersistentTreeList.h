@@ -0,0 +1,329 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <initializer_list>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// List with the same interface as TreeList, whose versions share nodes (path copying)
+// nodes are immutable once shared: modification copies only nodes on the path from root,
+// everything else is shared with older versions, so snapshot() is O(1)
+// nodes have no parent links and store size of their subtree instead of relative index,
+// because one node can be a child of different parents in different versions
+// nodes are freed by atomic reference count, so snapshots can be read and dropped by
+// other threads while the list itself is modified by one writer
+template <class T>
+class PersistentTreeList {
+    struct Node {
+        T value;
+        Node *left = nullptr, *right = nullptr;
+        unsigned long size = 1;
+        unsigned long height = 1;
+        std::atomic<unsigned long> references{1}; // parents and handles
+
+        explicit Node(const T& value) : value(value) {}
+
+        // copy shares children of other
+        Node(const Node& other) : value(other.value), left(other.left), right(other.right),
+                                  size(other.size), height(other.height) {
+            acquire(left);
+            acquire(right);
+        }
+    };
+
+    Node* root = nullptr;
+
+    static Node* acquire(Node* node) noexcept {
+        if (node)
+            node->references.fetch_add(1, std::memory_order_relaxed);
+        return node;
+    }
+
+    // drop one reference, free nodes nobody refers to
+    static void release(Node* node) noexcept {
+        while (node and node->references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            release(node->left);
+            Node* right = node->right;
+            delete node;
+            node = right; // loop instead of second recursion
+        }
+    }
+
+    // node, that can be modified in place: node itself if nothing else refers to it, copy otherwise
+    // takes over caller's reference to node
+    static Node* own(Node* node){
+        if (node->references.load(std::memory_order_acquire) == 1)
+            return node;
+        Node* copy = new Node(*node);
+        release(node);
+        return copy;
+    }
+
+    static unsigned long size(const Node* node) noexcept { return node ? node->size : 0; }
+    static unsigned long height(const Node* node) noexcept { return node ? node->height : 0; }
+    static long slope(const Node* node) noexcept { return long(height(node->right)) - long(height(node->left)); }
+
+    static void update(Node* node) noexcept {
+        node->size = 1 + size(node->left) + size(node->right);
+        node->height = 1 + std::max(height(node->left), height(node->right));
+    }
+
+    // node must be owned, same pictures as Node::left_rotate and Node::right_rotate
+    static Node* left_rotate(Node* node){
+        Node* right = own(node->right);
+        node->right = right->left;
+        right->left = node;
+        update(node);
+        update(right);
+        return right;
+    }
+
+    static Node* right_rotate(Node* node){
+        Node* left = own(node->left);
+        node->left = left->right;
+        left->right = node;
+        update(node);
+        update(left);
+        return left;
+    }
+
+    // owned node with balanced children, returns new root of subtree
+    static Node* balance(Node* node){
+        update(node);
+        long node_slope = slope(node);
+        if (node_slope == 2){
+            if (slope(node->right) < 0)
+                node->right = right_rotate(own(node->right));
+            return left_rotate(node);
+        }
+        if (node_slope == -2){
+            if (slope(node->left) > 0)
+                node->left = left_rotate(own(node->left));
+            return right_rotate(node);
+        }
+        return node;
+    }
+
+    static Node* insert(Node* node, unsigned long index, const T& value){
+        if (not node)
+            return new Node(value);
+        node = own(node);
+        unsigned long left_size = size(node->left);
+        if (index <= left_size)
+            node->left = insert(node->left, index, value);
+        else
+            node->right = insert(node->right, index - left_size - 1, value);
+        return balance(node);
+    }
+
+    static Node* remove(Node* node, unsigned long index){
+        node = own(node);
+        unsigned long left_size = size(node->left);
+        if (index < left_size)
+            node->left = remove(node->left, index);
+        else if (index > left_size)
+            node->right = remove(node->right, index - left_size - 1);
+        else if (node->left and node->right) { // take value of successor, remove successor instead
+            node->value = get_node(node->right, 0)->value;
+            node->right = remove(node->right, 0);
+        } else {
+            Node* child = node->left ? node->left : node->right;
+            node->left = node->right = nullptr;
+            delete node; // owned, so child's reference passes to the caller
+            return child;
+        }
+        return balance(node);
+    }
+
+    static Node* set(Node* node, unsigned long index, const T& value){
+        node = own(node);
+        unsigned long left_size = size(node->left);
+        if (index < left_size)
+            node->left = set(node->left, index, value);
+        else if (index > left_size)
+            node->right = set(node->right, index - left_size - 1, value);
+        else
+            node->value = value;
+        return node;
+    }
+
+    // perfectly balanced tree of count values taken in order from first, first is advanced
+    template <class InputIt>
+    static Node* build(InputIt& first, unsigned long count){
+        if (count == 0)
+            return nullptr;
+        Node* left = build(first, count / 2);
+        Node* node = new Node(*first);
+        ++first;
+        node->left = left;
+        node->right = build(first, count - count / 2 - 1);
+        update(node);
+        return node;
+    }
+
+    static const Node* get_node(const Node* node, unsigned long index) noexcept {
+        while (node){
+            unsigned long left_size = size(node->left);
+            if (index == left_size)
+                return node;
+            if (index < left_size)
+                node = node->left;
+            else {
+                index -= left_size + 1;
+                node = node->right;
+            }
+        }
+        return nullptr;
+    }
+
+    static const T& at(const Node* node, unsigned long index){
+        if (const Node* found = get_node(node, index))
+            return found->value;
+        throw std::out_of_range(std::to_string(index) + " is out of range");
+    }
+
+public:
+    // in-order iterator, keeps path from root, because nodes don't know their parents
+    class const_iterator {
+        friend class PersistentTreeList;
+        std::vector<const Node*> path; // top is current node, end() has empty path
+
+        explicit const_iterator(const Node* root) { descend(root); }
+
+        void descend(const Node* node){
+            for (; node; node = node->left)
+                path.push_back(node);
+        }
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef T value_type;
+        typedef long difference_type;
+        typedef const T* pointer;
+        typedef const T& reference;
+
+        const_iterator() = default;
+
+        reference operator*() const { return path.back()->value; }
+        pointer operator->() const { return &path.back()->value; }
+
+        const_iterator& operator++() {
+            const Node* node = path.back();
+            path.pop_back();
+            descend(node->right);
+            return *this;
+        }
+
+        const_iterator operator++(int) {
+            const_iterator copy = *this;
+            ++*this;
+            return copy;
+        }
+
+        bool operator==(const const_iterator& other) const noexcept {
+            return path.empty() ? other.path.empty() : not other.path.empty() and path.back() == other.path.back();
+        }
+        bool operator!=(const const_iterator& other) const noexcept { return not (*this == other); }
+    };
+
+    // immutable version of the list, stays valid and unchanged whatever happens to the list
+    // can be copied, read and destroyed in any thread
+    class Snapshot {
+        friend class PersistentTreeList;
+        Node* root = nullptr;
+
+        explicit Snapshot(Node* root) noexcept : root(acquire(root)) {}
+    public:
+        Snapshot() = default;
+        Snapshot(const Snapshot& other) noexcept : root(acquire(other.root)) {}
+        Snapshot(Snapshot&& other) noexcept : root(other.root) { other.root = nullptr; }
+        Snapshot& operator=(Snapshot other) noexcept {
+            std::swap(root, other.root);
+            return *this;
+        }
+        ~Snapshot() { release(root); }
+
+        const T& operator[](unsigned long index) const { return get_node(root, index)->value; }
+        const T& at(unsigned long index) const { return PersistentTreeList::at(root, index); }
+        unsigned long size() const noexcept { return PersistentTreeList::size(root); }
+        bool empty() const noexcept { return not root; }
+
+        const_iterator begin() const { return const_iterator(root); }
+        const_iterator end() const { return const_iterator(); }
+    };
+
+    PersistentTreeList() = default;
+    ~PersistentTreeList() { clear(); }
+
+    // O(1), both lists share all nodes until one of them is modified
+    PersistentTreeList(const PersistentTreeList& other) noexcept : root(acquire(other.root)) {}
+
+    PersistentTreeList(PersistentTreeList&& other) noexcept { swap(other); }
+
+    PersistentTreeList(const Snapshot& snapshot) noexcept : root(acquire(snapshot.root)) {}
+
+    template <class InputIt, class = typename std::iterator_traits<InputIt>::iterator_category>
+    PersistentTreeList(InputIt first, InputIt last) {
+        std::vector<T> values(first, last);
+        auto begin = values.begin();
+        root = build(begin, values.size());
+    }
+
+    PersistentTreeList(std::initializer_list<T> values) : PersistentTreeList(values.begin(), values.end()) {}
+
+    PersistentTreeList& operator=(PersistentTreeList other) noexcept {
+        swap(other);
+        return *this;
+    }
+
+    void swap(PersistentTreeList& other) noexcept {
+        std::swap(root, other.root);
+    }
+
+    void clear() noexcept {
+        release(root);
+        root = nullptr;
+    }
+
+    // O(1), list keeps being modifiable, snapshot doesn't see later changes
+    Snapshot snapshot() const noexcept {
+        return Snapshot(root);
+    }
+
+    // insert value before index, O(log n) new nodes
+    // if index >= number of items, insert after last
+    void insert(unsigned long index, const T& value){
+        root = insert(root, std::min(index, size()), value);
+    }
+
+    void push_back(const T& value){
+        root = insert(root, size(), value);
+    }
+
+    // remove value at index, do nothing if no such index
+    void remove(unsigned long index){
+        if (index < size())
+            root = remove(root, index);
+    }
+
+    // values can't be changed through references, because nodes may be shared
+    void set(unsigned long index, const T& value){
+        if (index >= size())
+            throw std::out_of_range(std::to_string(index) + " is out of range");
+        root = set(root, index, value);
+    }
+
+    const T& operator[](unsigned long index) const { return get_node(root, index)->value; }
+    const T& at(unsigned long index) const { return at(root, index); }
+    unsigned long size() const noexcept { return size(root); }
+    bool empty() const noexcept { return not root; }
+
+    const_iterator begin() const { return const_iterator(root); }
+    const_iterator end() const { return const_iterator(); }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+};
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <new>
+#include <vector>
+
+// slabs of PoolAllocator and all its rebound copies, every slot size has its own pool, there are few of them
+template <unsigned long slab_size>
+struct SlabPools {
+    // slots of one size and alignment
+    struct Pool {
+        std::size_t slot_size, alignment;
+        std::vector<char*> slabs;
+        void* free = nullptr; // head of free list, every free slot starts with pointer to the next one
+        char* cursor = nullptr; // next never used slot in last slab
+        char* slab_end = nullptr;
+
+        Pool(std::size_t slot_size, std::size_t alignment) : slot_size(slot_size), alignment(alignment) {}
+        Pool(const Pool&) = delete;
+        Pool& operator=(const Pool&) = delete;
+        ~Pool() { release(); }
+
+        void* allocate(){
+            if (free){
+                void* slot = free;
+                free = *static_cast<void**>(slot);
+                return slot;
+            }
+            if (cursor == slab_end){
+                cursor = static_cast<char*>(::operator new(slab_size * slot_size, std::align_val_t(alignment)));
+                slab_end = cursor + slab_size * slot_size;
+                slabs.push_back(cursor);
+            }
+            void* slot = cursor;
+            cursor += slot_size;
+            return slot;
+        }
+
+        void deallocate(void* slot) noexcept {
+            *static_cast<void**>(slot) = free;
+            free = slot;
+        }
+
+        void release() noexcept {
+            for (char* slab : slabs)
+                ::operator delete(slab, std::align_val_t(alignment));
+            slabs.clear();
+            free = nullptr;
+            cursor = slab_end = nullptr;
+        }
+    };
+
+    std::deque<Pool> pools; // pools don't move when new ones are added
+
+    Pool* find(std::size_t slot_size, std::size_t alignment) noexcept {
+        for (Pool& pool : pools)
+            if (pool.slot_size == slot_size and pool.alignment == alignment)
+                return &pool;
+        return nullptr;
+    }
+
+    void release() noexcept {
+        for (Pool& pool : pools)
+            pool.release();
+    }
+};
+
+// allocator for TreeList nodes
+// single objects are carved out of large slabs and recycled through intrusive free list,
+// arrays go to operator new
+// copies and rebound copies share the same pools, every slot size has its own one,
+// so PoolAllocator<A>(PoolAllocator<B>(a)) == a
+// slabs are freed when last copy dies or on release()
+template <class T, unsigned long slab_size = 4096>
+class PoolAllocator {
+    static constexpr std::size_t slot_alignment = std::max(alignof(T), alignof(void*));
+    static constexpr std::size_t slot_size = (std::max(sizeof(T), sizeof(void*)) + slot_alignment - 1)
+                                             / slot_alignment * slot_alignment;
+
+    typedef SlabPools<slab_size> Pools;
+    typedef typename Pools::Pool Pool;
+
+    std::shared_ptr<Pools> pools = std::make_shared<Pools>();
+    Pool* pool = nullptr; // pool of Ts, looked up on first allocation, rebinding doesn't allocate
+
+    Pool& own_pool(){
+        if (not pool)
+            pool = pools->find(slot_size, slot_alignment);
+        if (not pool)
+            pool = &pools->pools.emplace_back(slot_size, slot_alignment);
+        return *pool;
+    }
+
+    template <class, unsigned long> friend class PoolAllocator;
+public:
+    typedef T value_type;
+    typedef std::true_type propagate_on_container_copy_assignment;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    template <class U>
+    struct rebind { typedef PoolAllocator<U, slab_size> other; };
+
+    PoolAllocator() = default;
+    PoolAllocator(const PoolAllocator&) = default; // no move, moved from allocator must stay equal to the new one
+    PoolAllocator& operator=(const PoolAllocator&) = default;
+
+    template <class U>
+    PoolAllocator(const PoolAllocator<U, slab_size>& other) noexcept : pools(other.pools) {}
+
+    T* allocate(std::size_t n){
+        if (n == 1)
+            return static_cast<T*>(own_pool().allocate());
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T* pointer, std::size_t n) noexcept {
+        if (n == 1)
+            own_pool().deallocate(pointer); // pool exists, pointer came from it
+        else
+            ::operator delete(pointer);
+    }
+
+    // free all slabs at once, all allocated objects must be already destroyed
+    // does nothing while some copy still uses the pools
+    void release() noexcept {
+        if (pools.use_count() == 1)
+            pools->release();
+    }
+
+    // number of slabs currently held for Ts
+    std::size_t slab_count() const noexcept {
+        Pool* found = pools->find(slot_size, slot_alignment);
+        return found ? found->slabs.size() : 0;
+    }
+
+    template <class U>
+    bool operator==(const PoolAllocator<U, slab_size>& other) const noexcept {
+        return pools == other.pools;
+    }
+
+    template <class U>
+    bool operator!=(const PoolAllocator<U, slab_size>& other) const noexcept {
+        return not (*this == other);
+    }
+};
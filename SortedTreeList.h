@@ -0,0 +1,152 @@
+#pragma once
+
+#include "TreeList.h"
+#include "FrozenTreeList.h"
+#include <algorithm>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <vector>
+
+// sorted multiset on top of TreeList: order-statistic tree
+// elements are kept sorted by Compare, equal elements in order of insertion,
+// so position of an element is its rank, select(k) is at(k) and rank(value) is a descent by comparator,
+// all of them O(log n) thanks to relative indices TreeList already keeps
+// Policies are passed to TreeList, lazy updates aren't allowed because they would break the order
+template <class T, class Compare = std::less<T>, class... Policies>
+class SortedTreeList {
+public:
+    typedef TreeList<T, Policies...> List;
+    typedef typename List::NodePtr NodePtr;
+    typedef typename List::const_iterator const_iterator;
+    static_assert(not List::NodeType::lazy, "lazy updates change values, so order can't be kept");
+private:
+    List items;
+    [[no_unique_address]] Compare compare;
+
+    // number of elements, that go before value: less than value if strict, not greater otherwise
+    unsigned long bound(const T& value, bool strict) const {
+        NodePtr current = items.root;
+        if (not current)
+            return 0;
+        unsigned long current_index = current->diff, result = items.size();
+        while (true){
+            current->push();
+            bool before = strict ? compare(current->value, value) : not compare(value, current->value);
+            if (not before)
+                result = current_index;
+            NodePtr next = before ? current->right : current->left;
+            if (not next)
+                return result;
+            current = next;
+            current_index += current->diff;
+        }
+    }
+public:
+    SortedTreeList() = default;
+    explicit SortedTreeList(const Compare& compare) : compare(compare) {}
+
+    // O(n log n) for sorting, tree is built in O(n)
+    template <class InputIt, class = typename std::iterator_traits<InputIt>::iterator_category>
+    SortedTreeList(InputIt first, InputIt last, const Compare& compare = Compare()) : compare(compare) {
+        std::vector<T> values(first, last);
+        std::stable_sort(values.begin(), values.end(), this->compare);
+        items.assign(std::make_move_iterator(values.begin()), std::make_move_iterator(values.end()));
+    }
+
+    SortedTreeList(std::initializer_list<T> values, const Compare& compare = Compare())
+        : SortedTreeList(values.begin(), values.end(), compare) {}
+
+    // insert after all elements equal to value, returns its position, O(log n)
+    // one descent by comparator, that shifts indices on the way like TreeList::emplace
+    unsigned long insert_sorted(const T& value){
+        NodePtr node = items.create_node(0, value);
+        ++items._size;
+        if (not items.root){
+            items.root = node;
+            items.attached(node, 0);
+            return 0;
+        }
+        NodePtr current = items.root;
+        unsigned long current_index = current->diff;
+        while (true){
+            current->push();
+            if (compare(value, current->value)){ // goes before current, current and its right half move by one
+                ++current->diff;
+                ++current_index;
+                if (not current->left){
+                    node->diff = -1;
+                    current->make_left(node);
+                    break;
+                }
+                --current->left->diff; // left half stays where it was
+                current = current->left;
+            } else {
+                if (not current->right){
+                    node->diff = 1;
+                    current->make_right(node);
+                    break;
+                }
+                current = current->right;
+            }
+            current_index += current->diff;
+        }
+        unsigned long position = current_index + node->diff; // before rotations change diffs
+        items.attached(node, position);
+        node->pull_path();
+        items.fix(current);
+        return position;
+    }
+
+    // number of elements less than value, that is position of first element not less than value, O(log n)
+    unsigned long rank(const T& value) const {
+        return bound(value, true);
+    }
+
+    // number of elements not greater than value
+    unsigned long upper_rank(const T& value) const {
+        return bound(value, false);
+    }
+
+    unsigned long count(const T& value) const {
+        return upper_rank(value) - rank(value);
+    }
+
+    // k-th smallest element, O(log n)
+    const T& select(unsigned long k) const {
+        return items.at(k);
+    }
+
+    const T& operator[](unsigned long index) const {
+        return items[index];
+    }
+
+    // remove element at position, O(log n)
+    void remove(unsigned long index){
+        items.remove(index);
+    }
+
+    // remove one element equal to value, false if there is none
+    bool erase(const T& value){
+        unsigned long index = rank(value);
+        if (index == items.size() or compare(value, items[index]))
+            return false;
+        items.remove(index);
+        return true;
+    }
+
+    void clear() { items.clear(); }
+    unsigned long size() const noexcept { return items.size(); }
+    bool empty() const noexcept { return items.empty(); }
+
+    // flat copy with search index, see FrozenTreeList.h
+    FrozenTreeList<T, Compare> freeze() const {
+        return items.freeze(true, compare);
+    }
+
+    // underlying list, e.g. for reduce over a range of ranks
+    const List& list() const noexcept { return items; }
+
+    const_iterator begin() const { return items.begin(); }
+    const_iterator end() const { return items.end(); }
+};
@@ -0,0 +1,207 @@
+#pragma once
+
+#include <cassert>
+#include <cstdlib>
+
+// Balance policy of TreeList restores balance after a node is attached or removed
+// it uses Node::left_rotate and Node::right_rotate, which keep diffs and aggregates correct,
+// and keeps its rank information in Node::height, so join and split, which compare heights, work with any policy
+// every hook returns new root of the tree if rebalancing reached it, nullptr otherwise
+//   inserted(node, stats) - node got a new or higher child, node's own height may be stale
+//   erased(node, left, stats) - node's left or right subtree lost a node
+//   valid(node) - invariant of one node, for tests
+
+// strict AVL: heights of subtrees differ at most by one, height <= 1.44 log2 n
+// insertion rotates at most twice, deletion may rotate at every level up to root
+struct AvlBalance {
+    template <class Node, class Stats>
+    static Node* inserted(Node* node, Stats& stats){
+        node->fix_height();
+        return rebalance(node, stats);
+    }
+
+    template <class Node, class Stats>
+    static Node* erased(Node* node, bool, Stats& stats){ // heights show the side that lost a node
+        node->fix_height();
+        return rebalance(node, stats);
+    }
+
+    template <class Node>
+    static bool valid(const Node* node){
+        return node->height_is_correct() and not node->bad_slope();
+    }
+private:
+    // assumes correct height of node and unfixed height of it's parent
+    template <class Node, class Stats>
+    static Node* rebalance(Node* node, Stats& stats){
+        long slope = node->slope();
+        unsigned long steps = 0;
+        do {
+            ++steps;
+            assert(slope == 2 or slope == -2 or slope == 1 or slope == -1 or slope == 0);
+            if (slope == 2){
+                node->right->push(); // children of heavy side weren't visited
+                if (node->right->slope() < 0) { // == -1, left-heavy,
+                    node->right->right_rotate(); // change zig-zag path to zig-zig, not zag-zig
+                    stats.rotation();
+                }
+                node->left_rotate();
+                stats.rotation();
+                node = node->parent; // rotation moved node down
+            } else if (slope == -2){
+                node->left->push();
+                if (node->left->slope() > 0) {
+                    node->left->left_rotate();
+                    stats.rotation();
+                }
+                node->right_rotate();
+                stats.rotation();
+                node = node->parent;
+            }
+
+            if (not node->parent) { // root is rotated down
+                stats.rebalance(steps);
+                return node;
+            }
+            node = node->parent;
+            node->fix_height(); // rotations doesn't change upper heights
+            slope = node->slope();
+        } while (node->bad_slope() or (node->parent and
+                (not node->parent->height_is_correct() or node->parent->bad_slope())));
+        stats.rebalance(steps);
+        return nullptr;
+    }
+};
+
+// weak AVL (Haeupler, Sen, Tarjan. Rank-balanced trees): height is rank, missing node has rank 0,
+// rank of parent exceeds rank of child by 1 or 2, leaves have rank 1
+// without deletions the tree is AVL, with them height is still <= 2 log2 n
+// both insertion and deletion rotate at most twice, and amortized O(1) ranks change per update,
+// deletion mostly stops after a few demotions instead of walking to the root
+struct WavlBalance {
+    template <class Node, class Stats>
+    static Node* inserted(Node* node, Stats& stats){
+        unsigned long steps = 1;
+        Node* x = node; // x may have the same rank as its parent
+        node->push();
+        if (node->left and node->left->height == node->height)
+            x = node->left;
+        else if (node->right and node->right->height == node->height)
+            x = node->right;
+        while (x->parent and x->parent->height == x->height){
+            ++steps;
+            Node* p = x->parent;
+            bool left = x->is_left();
+            Node* sibling = left ? p->right : p->left;
+            if (long(p->height) - rank(sibling) == 1){ // promote and go up
+                ++p->height;
+                x = p;
+                continue;
+            }
+            x->push();
+            Node* outer = left ? x->left : x->right;
+            Node* inner = left ? x->right : x->left;
+            long rank_x = x->height;
+            if (rank_x - rank(inner) == 1 and rank_x - rank(outer) == 2){ // inner goes up
+                rotate_up(inner, stats);
+                rotate_up(inner, stats);
+                inner->height = rank_x;
+                x->height = rank_x - 1;
+                p->height = rank_x - 1;
+                x = inner;
+                break;
+            }
+            rotate_up(x, stats);
+            if (rank_x - rank(inner) == 2) { // outer has difference 1, p is demoted
+                p->height = rank_x - 1;
+                x->height = rank_x;
+                break;
+            }
+            // both children of x had difference 1, possible only after join, x is promoted instead
+            p->height = rank_x;
+            x->height = rank_x + 1;
+        }
+        stats.rebalance(steps);
+        return x->parent ? nullptr : x;
+    }
+
+    template <class Node, class Stats>
+    static Node* erased(Node* p, bool left, Stats& stats){
+        unsigned long steps = 1;
+        p->push();
+        Node* x = left ? p->left : p->right; // subtree, that lost a node, may be empty
+        Node* top = p;
+        if (not p->left and not p->right and p->height == 2){ // leaf of rank 2 is demoted
+            p->height = 1;
+            x = p;
+            left = x->is_left();
+            p = p->parent;
+            top = x;
+        }
+        while (p and long(p->height) - rank(x) == 3){
+            ++steps;
+            p->push();
+            Node* sibling = left ? p->right : p->left;
+            long rank_p = p->height, rank_sibling = sibling->height;
+            top = p;
+            if (rank_p - rank_sibling == 2){ // demote and go up
+                --p->height;
+                x = p;
+                left = x->is_left();
+                p = p->parent;
+                continue;
+            }
+            sibling->push();
+            Node* outer = left ? sibling->right : sibling->left;
+            Node* inner = left ? sibling->left : sibling->right;
+            if (rank_sibling - rank(outer) == 2 and rank_sibling - rank(inner) == 2){ // both demoted, go up
+                --p->height;
+                --sibling->height;
+                x = p;
+                left = x->is_left();
+                p = p->parent;
+                continue;
+            }
+            if (rank_sibling - rank(outer) == 1){ // sibling goes up
+                rotate_up(sibling, stats);
+                sibling->height = rank_sibling + 1;
+                p->height = p->left or p->right ? rank_p - 1 : 1;
+                top = sibling;
+            } else { // inner goes up
+                long rank_inner = inner->height;
+                rotate_up(inner, stats);
+                rotate_up(inner, stats);
+                inner->height = rank_inner + 2;
+                sibling->height = rank_sibling - 1;
+                p->height = rank_p - 2;
+                top = inner;
+            }
+            break;
+        }
+        stats.rebalance(steps);
+        return top->parent ? nullptr : top;
+    }
+
+    template <class Node>
+    static bool valid(const Node* node){
+        long left = long(node->height) - rank(node->left), right = long(node->height) - rank(node->right);
+        bool leaf = not node->left and not node->right;
+        return (left == 1 or left == 2) and (right == 1 or right == 2) and (not leaf or node->height == 1);
+    }
+private:
+    // Link is Node* or a layout link, like OffsetPtr of CompactLayout
+    template <class Link>
+    static long rank(const Link& node) noexcept {
+        return node ? node->height : 0;
+    }
+
+    // rotate node above its parent
+    template <class Node, class Stats>
+    static void rotate_up(Node* node, Stats& stats){
+        if (node->is_left())
+            node->parent->right_rotate();
+        else
+            node->parent->left_rotate();
+        stats.rotation();
+    }
+};
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <functional>
+#include <unordered_map>
+#include <utility>
+
+// Index policy of TreeList maps values to nodes holding them, so TreeList::find doesn't scan
+// nodes never move in memory, rotations only relink them, so entries stay valid until the node is destroyed
+// TreeList calls insert for every created node, erase before destroying one, and relink when remove
+// moves successor's value into the removed node
+// NoIndex, the default, has empty hooks and takes no space
+// custom policy has to provide the same hooks and enabled
+
+struct NoIndex {
+    static constexpr bool enabled = false;
+
+    template <class T>
+    void insert(const T&, const void*) noexcept {}
+    template <class T>
+    void erase(const T&, const void*) noexcept {}
+    template <class T>
+    void relink(const T&, const void*, const void*) noexcept {}
+    void clear() noexcept {}
+};
+
+// hash multimap from value to every node holding an equal value
+// values are copied into the map, so it suits small values and keys
+template <class T, class Hash = std::hash<T>, class Equal = std::equal_to<T>>
+class HashIndex {
+    std::unordered_multimap<T, const void*, Hash, Equal> nodes;
+
+    auto find(const T& value, const void* node) {
+        auto [first, last] = nodes.equal_range(value);
+        while (first != last and first->second != node)
+            ++first;
+        return first == last ? nodes.end() : first;
+    }
+public:
+    static constexpr bool enabled = true;
+
+    void insert(const T& value, const void* node) {
+        nodes.emplace(value, node);
+    }
+
+    void erase(const T& value, const void* node) {
+        auto found = find(value, node);
+        if (found != nodes.end())
+            nodes.erase(found);
+    }
+
+    void relink(const T& value, const void* from, const void* to) {
+        auto found = find(value, from);
+        if (found != nodes.end())
+            found->second = to;
+    }
+
+    void clear() noexcept {
+        nodes.clear();
+    }
+
+    // nodes holding values equal to value, in no particular order
+    auto equal_range(const T& value) const {
+        return nodes.equal_range(value);
+    }
+
+    unsigned long size() const noexcept {
+        return nodes.size();
+    }
+};
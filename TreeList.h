@@ -1,18 +1,73 @@
 #pragma once
 
 #include "Node.h"
+#include "TreeStats.h"
+#include "TreeIndex.h"
+#include "TreeBalance.h"
 #include <cassert>
 #include <stdexcept>
 #include <stack>
+#include <utility>
+#include <memory>
+#include <iterator>
+#include <type_traits>
+#include <initializer_list>
+#include <vector>
+#include <algorithm>
+#include <span>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <functional>
 
-// heights of subtrees differ at most by one
-template <class T, typename allocator=std::allocator<Node<T>>>
+// allocators that can free all their memory at once, like PoolAllocator
+template <class allocator, class = void>
+struct has_release : std::false_type {};
+
+template <class allocator>
+struct has_release<allocator, std::void_t<decltype(std::declval<allocator&>().release())>> : std::true_type {};
+
+// header of binary file written by TreeList::save, elements follow in order, native byte order
+struct TreeListFileHeader {
+    char magic[8] = {'T', 'r', 'e', 'e', 'L', 'i', 's', 't'};
+    std::uint32_t version = 1;
+    std::uint32_t value_size = 0; // sizeof(T), catches loading with wrong type
+    std::uint64_t count = 0;
+};
+
+// read-only flat copy, see FrozenTreeList.h
+template <class T, class Compare>
+class FrozenTreeList;
+
+// Balance keeps the tree balanced, AVL by default: heights of subtrees differ at most by one, see TreeBalance.h
+// allocator is rebound to node type, so both TreeList<int, PoolAllocator<int>> and
+// TreeList<int, PoolAllocator<Node<int>>> work
+// Stats counts rotations, descents and allocations, see TreeStats.h
+// Index finds nodes by value, see TreeIndex.h
+template <class T, typename allocator=std::allocator<Node<T>>, class Layout=PointerLayout, class Augment=NoAugment,
+          class Stats=NoStats, class Index=NoIndex, class Balance=AvlBalance>
 class TreeList {
 public: // just for debugging simplicity
-    allocator _allocator;
-    typedef Node<T> NodeType;
+    typedef Node<T, Layout, Augment> NodeType;
     typedef NodeType* NodePtr;
+    typedef Stats StatsType;
+    typedef Balance BalanceType;
+    typedef Index IndexType;
+    typedef typename std::allocator_traits<allocator>::template rebind_alloc<NodeType> node_allocator;
+    node_allocator _allocator;
     NodePtr root = nullptr;
+    unsigned long _size = 0;
+    [[no_unique_address]] mutable Stats _stats; // const lookups are counted too
+    [[no_unique_address]] Index _index;
+    // first and last nodes for O(1) front and back operations, nodes don't move during rotations,
+    // so they change only when ends are inserted or removed
+    // lazy and reversible lists don't use them: values and shape below pending updates aren't current
+    static constexpr bool cache_ends = not NodeType::lazy and not NodeType::reversible;
+    NodePtr leftmost = nullptr, rightmost = nullptr;
+    static_assert(not Index::enabled or not NodeType::lazy, "lazy updates change values behind index's back");
+    // with Index elements are read-only through references and iterators, index would keep their old values,
+    // change them with set()
+    typedef std::conditional_t<Index::enabled, const T, T> element_type;
 public:
     TreeList()= default;
     ~TreeList(){ clear(); }
@@ -20,25 +75,29 @@ public:
     void swap(TreeList& other)
     {
         std::swap(root, other.root);
+        std::swap(_size, other._size);
         std::swap(_allocator, other._allocator);
+        std::swap(_index, other._index);
+        std::swap(leftmost, other.leftmost);
+        std::swap(rightmost, other.rightmost);
     }
 
-    TreeList(const TreeList& other)
-    {
-        // TODO improve performance
-        for (unsigned long index = 0; true; ++index){
-            try{
-                insert(index, other.at(index));
-            } catch (std::out_of_range& ex){
-                break;
-            }
-        }
+    TreeList(const TreeList& other) : _size(other._size) {
+        root = clone(other.root, nullptr); // in body, so that stats and index already exist
+        find_ends();
     }
 
-    TreeList(TreeList&& other) noexcept { swap(other); }
+    template <class InputIt, class = typename std::iterator_traits<InputIt>::iterator_category>
+    TreeList(InputIt first, InputIt last) { assign(first, last); }
+
+    TreeList(std::initializer_list<T> values) { assign(values.begin(), values.end()); }
+
+    // allocator is copied, default constructed one may allocate, copying allocators doesn't throw
+    TreeList(TreeList&& other) noexcept : _allocator(other._allocator) { swap(other); }
 
     TreeList& operator=(TreeList&& other) noexcept
     {
+        clear(); // don't keep old nodes alive until other dies
         swap(other);
         return *this;
     }
@@ -54,26 +113,400 @@ public:
 
     void clear()
     {
-        // TODO improve by iterating through all nodes
-        while (root)
-            remove(root->diff);
+        _index.clear(); // erasing from empty index is cheaper than erasing every node
+        destroy(root);
         root = nullptr;
+        _size = 0;
+        leftmost = rightmost = nullptr;
+        if constexpr (has_release<node_allocator>::value)
+            _allocator.release(); // nodes are already destroyed, give slabs back
+    }
+
+    // replace content with [first, last), builds balanced tree in O(n) without rebalancing
+    template <class InputIt, class = typename std::iterator_traits<InputIt>::iterator_category>
+    void assign(InputIt first, InputIt last){
+        clear();
+        typedef typename std::iterator_traits<InputIt>::iterator_category category;
+        if constexpr (std::is_base_of_v<std::forward_iterator_tag, category>) {
+            _size = std::distance(first, last);
+            root = build(first, _size);
+        } else { // single pass iterator, count is unknown before reading everything
+            std::vector<T> values(first, last);
+            auto begin = std::make_move_iterator(values.begin());
+            _size = values.size();
+            root = build(begin, _size);
+        }
+        find_ends();
+    }
+
+    void assign(std::initializer_list<T> values){
+        assign(values.begin(), values.end());
+    }
+
+    // recompute cached ends after the tree was rebuilt, O(log n)
+    void find_ends(){
+        if constexpr (cache_ends) {
+            leftmost = root ? root->min() : nullptr;
+            rightmost = root ? root->max() : nullptr;
+        }
+    }
+
+    // update cached ends after node was attached at index, _size already counts it
+    void attached(NodePtr node, unsigned long index) noexcept {
+        if constexpr (cache_ends) {
+            if (index == 0)
+                leftmost = node;
+            if (index + 1 >= _size)
+                rightmost = node;
+        }
+    }
+
+    // value is constructed in place from args
+    template <class... Args>
+    NodePtr create_node(long diff, Args&&... args){
+        _stats.allocation();
+        NodePtr node = this->_allocator.allocate(1);
+        try {
+            new (node) NodeType(diff, std::forward<Args>(args)...);
+        } catch (...) {
+            this->_allocator.deallocate(node, 1);
+            throw;
+        }
+        try {
+            _index.insert(node->value, node);
+        } catch (...) {
+            node->~NodeType();
+            this->_allocator.deallocate(node, 1);
+            throw;
+        }
+        return node;
+    }
+
+    void destroy_node(NodePtr node){
+        _stats.deallocation();
+        _index.erase(node->value, node);
+        node->~NodeType();
+        this->_allocator.deallocate(node, 1);
+    }
+
+    // destroy every node of subtree exactly once in post-order, no rebalancing
+    // walks through parent links, so no extra memory is needed
+    void destroy(NodePtr node){
+        if (not node)
+            return;
+        NodePtr stop = node->parent;
+        node->set_parent_ref(nullptr);
+        while (node != stop){
+            if (node->left)
+                node = node->left;
+            else if (node->right)
+                node = node->right;
+            else {
+                NodePtr parent = node->parent;
+                node->set_parent_ref(nullptr);
+                destroy_node(node);
+                node = parent;
+            }
+        }
+    }
+
+    // perfectly balanced tree of count values taken in order from first, first is advanced
+    // returned node's diff is its index inside built tree, as if it was root
+    template <class InputIt>
+    NodePtr build(InputIt& first, unsigned long count){
+        if (count == 0)
+            return nullptr;
+        unsigned long left_count = count / 2;
+        NodePtr left = build(first, left_count);
+        NodePtr node = nullptr, right;
+        try { // reading from first may throw, built part must not leak
+            node = create_node(left_count, *first);
+            ++first;
+            right = build(first, count - left_count - 1);
+        } catch (...) {
+            destroy(left);
+            if (node)
+                destroy_node(node);
+            throw;
+        }
+        if (left) {
+            left->diff -= node->diff; // [0, left_count) relative to left_count
+            node->make_left(left);
+        }
+        if (right) {
+            right->diff += 1; // right half starts after node
+            node->make_right(right);
+        }
+        node->fix_height();
+        node->pull();
+        return node;
+    }
+
+    // binary snapshot: TreeListFileHeader, then elements in order, written chunk by chunk
+    void save(std::ostream& stream, unsigned long chunk = 4096) const {
+        static_assert(std::is_trivially_copyable_v<T>, "save writes raw bytes of elements");
+        TreeListFileHeader header;
+        header.value_size = sizeof(T);
+        header.count = _size;
+        stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        std::vector<T> buffer;
+        buffer.reserve(std::min<unsigned long>(chunk, _size));
+        auto flush = [&]{
+            stream.write(reinterpret_cast<const char*>(buffer.data()), buffer.size() * sizeof(T));
+            buffer.clear();
+        };
+        for (NodePtr node = root ? root->min() : nullptr; node; node = node->next()){
+            buffer.push_back(node->value);
+            if (buffer.size() == chunk)
+                flush();
+        }
+        flush();
+        if (not stream)
+            throw std::runtime_error("failed to write TreeList");
+    }
+
+    // flat read-only copy of elements for long read-only phases, O(n), needs FrozenTreeList.h
+    // index for lower_bound is built too if sorted is true, elements must be sorted by Compare then
+    template <class Compare = std::less<T>>
+    FrozenTreeList<T, Compare> freeze(bool sorted = false, const Compare& compare = Compare()) const {
+        std::vector<T> values;
+        values.reserve(_size);
+        for (NodePtr node = root ? root->min() : nullptr; node; node = node->next())
+            values.push_back(node->value);
+        FrozenTreeList<T, Compare> result(std::move(values), compare);
+        if (sorted)
+            result.build_index();
+        return result;
+    }
+
+    // reads values saved by save, keeps at most chunk of them in memory
+    // build only needs * and ++, so this is all of the iterator it gets
+    class StreamReader {
+        std::istream& stream;
+        std::vector<T> buffer;
+        unsigned long position = 0, remaining, chunk;
+
+        void refill(){
+            buffer.resize(std::min(chunk, remaining));
+            stream.read(reinterpret_cast<char*>(buffer.data()), buffer.size() * sizeof(T));
+            if (static_cast<unsigned long>(stream.gcount()) != buffer.size() * sizeof(T))
+                throw std::runtime_error("TreeList file is truncated");
+            remaining -= buffer.size();
+            position = 0;
+        }
+    public:
+        StreamReader(std::istream& stream, unsigned long count, unsigned long chunk)
+            : stream(stream), remaining(count), chunk(std::max(1ul, std::min(chunk, count))) {}
+
+        const T& operator*(){
+            if (position == buffer.size())
+                refill();
+            return buffer[position];
+        }
+
+        StreamReader& operator++(){
+            ++position;
+            return *this;
+        }
+    };
+
+    // replace content with elements written by save, O(n), balanced tree is built directly
+    // throws std::runtime_error on foreign or truncated file and leaves the list empty
+    void load(std::istream& stream, unsigned long chunk = 4096){
+        static_assert(std::is_trivially_copyable_v<T>, "load reads raw bytes of elements");
+        clear();
+        TreeListFileHeader header, expected;
+        stream.read(reinterpret_cast<char*>(&header), sizeof(header));
+        if (stream.gcount() != sizeof(header) or not std::equal(header.magic, header.magic + 8, expected.magic))
+            throw std::runtime_error("not a TreeList file");
+        if (header.version != expected.version or header.value_size != sizeof(T))
+            throw std::runtime_error("TreeList file has different version or element type");
+        StreamReader reader(stream, header.count, chunk);
+        root = build(reader, header.count);
+        _size = header.count;
+        find_ends();
+    }
+
+    // copy of subtree with same shape, diffs and heights
+    NodePtr clone(NodePtr node, NodePtr parent){
+        if (not node)
+            return nullptr;
+        NodePtr copy = create_node(node->diff, node->value);
+        copy->height = node->height;
+        copy->parent = parent;
+        try { // copying values may throw, cloned part must not leak
+            copy->left = clone(node->left, copy);
+            copy->right = clone(node->right, copy);
+        } catch (...) {
+            destroy(copy); // parent doesn't link to copy yet, destroy stops at it
+            throw;
+        }
+        static_cast<AugmentStorage<Augment>&>(*copy) = *node; // aggregate and pending updates
+        return copy;
     }
 
+    // insert [first, last) before index, O(log n + k)
+    // inserted values are built into balanced tree, which is joined with both halves of the list
+    template <class InputIt, class = typename std::iterator_traits<InputIt>::iterator_category>
+    void insert(unsigned long index, InputIt first, InputIt last){
+        typedef typename std::iterator_traits<InputIt>::iterator_category category;
+        if constexpr (not std::is_base_of_v<std::forward_iterator_tag, category>) {
+            std::vector<T> values(first, last);
+            insert(index, std::make_move_iterator(values.begin()), std::make_move_iterator(values.end()));
+        } else {
+            unsigned long count = std::distance(first, last);
+            if (count == 0)
+                return;
+            index = std::min(index, _size);
+            // copying values may throw, so inserted run is made before the list is split
+            NodePtr front = create_node(0, *first), middle = nullptr, back = nullptr;
+            ++first;
+            if (count > 1) {
+                try {
+                    middle = build(first, count - 2);
+                    back = create_node(0, *first);
+                } catch (...) {
+                    destroy(middle);
+                    destroy_node(front);
+                    throw;
+                }
+            }
+            auto [before, after] = split(root, _size, index);
+            _size += count;
+            if (count == 1)
+                root = join(before, index, front, after);
+            else
+                root = join(join(before, index, front, middle), index + count - 1, back, after);
+            find_ends();
+        }
+    }
+
+    // remove [first, last), O(log n + k)
+    // do nothing for indices after end
+    void erase(unsigned long first, unsigned long last){
+        last = std::min(last, _size);
+        if (first >= last)
+            return;
+        auto [rest, after] = split(root, _size, last);
+        auto [before, removed] = split(rest, last, first);
+        destroy(removed);
+        _size -= last - first;
+        root = concat(before, first, after);
+        find_ends();
+    }
+
+    // insert values before given indices, O(k log(n / k + 1))
+    // indices refer to the list before the batch and must be sorted, equal ones keep their order
+    // batch is split along the tree in one recursive pass, halves are joined back on the way up
+    // small batch is cheaper to insert one by one
+    void insert_batch(std::span<const std::pair<unsigned long, T>> batch){
+        assert(std::is_sorted(batch.begin(), batch.end(),
+                              [](const auto& a, const auto& b){ return a.first < b.first; }));
+        unsigned long size = _size;
+        if (batch.size() * batch_ratio < size){
+            for (unsigned long i = 0; i < batch.size(); ++i) // earlier inserts move later indices
+                insert(std::min(batch[i].first, size) + i, batch[i].second);
+            return;
+        }
+        // copying values may throw, so all nodes are made before the tree is cut apart
+        std::vector<NodePtr> nodes;
+        nodes.reserve(batch.size());
+        try {
+            for (const auto& edit : batch)
+                nodes.push_back(create_node(0, edit.second));
+        } catch (...) {
+            for (NodePtr node : nodes)
+                destroy_node(node);
+            throw;
+        }
+        root = insert_batch(root, size, batch, nodes, 0);
+        _size += batch.size();
+        find_ends();
+    }
+
+    // batch indices minus base are relative to tree, nodes[i] holds value of batch[i]
+    NodePtr insert_batch(NodePtr tree, unsigned long size, std::span<const std::pair<unsigned long, T>> batch,
+                         std::span<const NodePtr> nodes, unsigned long base){
+        if (batch.empty())
+            return tree;
+        if (not tree){ // rest of batch goes here in order, middle one becomes root
+            unsigned long middle = batch.size() / 2;
+            NodePtr left = insert_batch(nullptr, 0, batch.first(middle), nodes.first(middle), base);
+            NodePtr right = insert_batch(nullptr, 0, batch.subspan(middle + 1), nodes.subspan(middle + 1), base);
+            return join(left, middle, nodes[middle], right);
+        }
+        unsigned long node_index = tree->diff;
+        auto [left, right] = cut(tree);
+        unsigned long lower = std::partition_point(batch.begin(), batch.end(), [&](const auto& edit){
+            return edit.first - base <= node_index;
+        }) - batch.begin();
+        left = insert_batch(left, node_index, batch.first(lower), nodes.first(lower), base);
+        right = insert_batch(right, size - node_index - 1, batch.subspan(lower), nodes.subspan(lower),
+                             base + node_index + 1);
+        return join(left, node_index + lower, tree, right);
+    }
+
+    // remove values at given indices, O(k log(n / k + 1))
+    // indices refer to the list before the batch and must be sorted, repeated and missing ones are ignored
+    void remove_batch(std::span<const unsigned long> indices){
+        assert(std::is_sorted(indices.begin(), indices.end()));
+        if (indices.size() * batch_ratio < _size){
+            for (unsigned long i = indices.size(); i-- > 0;) // from the back, so indices stay valid
+                if (i + 1 == indices.size() or indices[i] != indices[i + 1])
+                    remove(indices[i]);
+            return;
+        }
+        std::tie(root, _size) = remove_batch(root, _size, indices, 0);
+        find_ends();
+    }
+
+    // new tree and its size
+    std::pair<NodePtr, unsigned long> remove_batch(NodePtr tree, unsigned long size,
+                                                   std::span<const unsigned long> indices, unsigned long base){
+        if (indices.empty() or not tree)
+            return {tree, size};
+        unsigned long node_index = tree->diff;
+        auto [left, right] = cut(tree);
+        auto lower = std::lower_bound(indices.begin(), indices.end(), base + node_index);
+        auto upper = std::upper_bound(lower, indices.end(), base + node_index);
+        auto [new_left, left_size] = remove_batch(left, node_index, indices.first(lower - indices.begin()), base);
+        auto [new_right, right_size] = remove_batch(right, size - node_index - 1,
+                                                    indices.subspan(upper - indices.begin()), base + node_index + 1);
+        if (lower == upper)
+            return {join(new_left, left_size, tree, new_right), left_size + right_size + 1};
+        destroy_node(tree);
+        return {concat(new_left, left_size, new_right), left_size + right_size};
+    }
+
+    // batches smaller than 1 / batch_ratio of the list are applied one by one,
+    // cutting and joining every node on their paths costs more than separate descents
+    static constexpr unsigned long batch_ratio = 16;
+
     // insert value before index
     // if index >= number of items, insert after last
-    // TODO pass by &, &&
     void insert(unsigned long index, const T& value){
+        emplace(index, value);
+    }
+
+    void insert(unsigned long index, T&& value){
+        emplace(index, std::move(value));
+    }
+
+    // construct value from args in new node before index, no temporary T is made
+    template <class... Args>
+    element_type& emplace(unsigned long index, Args&&... args){
+        NodePtr node = create_node(0, std::forward<Args>(args)...); // before changing anything, may throw
+        ++_size;
         if (root == nullptr){
-            root = this->_allocator.allocate(1);
-            new (root) NodeType(0, value);
-            return;
+            root = leftmost = rightmost = node;
+            return node->value;
         }
 
         // offset everything after index (inclusive) by one
         NodePtr current = root;
-        unsigned long current_index = current->diff;
+        unsigned long current_index = current->diff, depth = 1;
         while (true){
+            current->push();
             if (index == current_index){
                 ++current->diff; // offset with the left half. NOTE current index was not given any offset
                 ++current_index;
@@ -82,16 +515,14 @@ public:
                     current = current->left;
                     // continue searching to find and insert
                 } else {
-                    NodePtr node = this->_allocator.allocate(1);
-                    new (node) NodeType(-1, value);
+                    node->diff = -1;
                     current->make_left(node);
                     break;
                 }
 
             } else if (index > current_index){ // don't need to offset anything
                 if (not current->right) { // found !!!
-                    NodePtr node = this->_allocator.allocate(1);
-                    new (node) NodeType(1, value);
+                    node->diff = 1;
                     current->make_right(node); // insert new node
                     break;
                 }
@@ -100,8 +531,7 @@ public:
                 ++current->diff; // offset with the left half. current_index wasn't given any offset
                 ++current_index;
                 if (not current->left) {
-                    NodePtr node = this->_allocator.allocate(1);
-                    new (node) NodeType(-1, value);
+                    node->diff = -1;
                     current->make_left(node);
                     break;
                 }
@@ -110,9 +540,14 @@ public:
                 current = current->left;
             }
             current_index += current->diff;
+            ++depth;
         }
+        _stats.descent(depth);
+        attached(node, index);
 
+        node->pull_path();
         fix(current);
+        return node->value;
     }
 
     // move all elements left that lie after index
@@ -123,15 +558,19 @@ public:
             return nullptr;
         // looking for node and moving parts of list to the left if we need to
         NodePtr current = root;
-        unsigned long current_index = current->diff;
+        unsigned long current_index = current->diff, depth = 1;
         while (true){
+            current->push();
             if (index == current_index){
                 if (current->right)
                     --current->right->diff; // move right part to the left
+                _stats.descent(depth);
                 return current; // found
             } else if (index > current_index){
-                if (not current->right) // index is too big
+                if (not current->right) { // index is too big
+                    _stats.descent(depth);
                     return nullptr;
+                }
                 current = current->right;
             } else { // index < current_index
                 assert(current->left); // in list no missing indices possible
@@ -144,6 +583,7 @@ public:
                 current = current->left;
             }
             current_index += current->diff;
+            ++depth;
         }
     }
 
@@ -153,9 +593,20 @@ public:
     void remove(unsigned long index){
 
         NodePtr target = move_left(index);
-        if (not target)
-            return;
+        if (target)
+            erase_node(target);
+    }
 
+    // unlink and destroy node, indices after it must already be moved left
+    void erase_node(NodePtr target){
+        bool from_left = target->is_left(); // side of parent, that loses a node
+        if constexpr (cache_ends) {
+            if (target == leftmost)
+                leftmost = target->next();
+            if (target == rightmost)
+                rightmost = target->prev();
+        }
+        --_size;
         NodePtr parent = target->parent;
 
         // removing element
@@ -180,13 +631,24 @@ public:
         }
         else { // find next (min, but larger then target) and place here
             NodePtr successor = target->successor();
+            if constexpr (not std::is_same_v<Stats, NoStats>) {
+                unsigned long depth = 0;
+                for (NodePtr node = successor; node != target; node = node->parent)
+                    ++depth;
+                _stats.successor(depth);
+            }
             assert(successor != root);
             assert(successor);
             assert(not successor->left);
             assert(target->right);
 
+            _index.erase(target->value, target);
+            _index.relink(successor->value, successor, target); // successor is destroyed holding moved-from value
+            if (successor == rightmost) // target takes its place in order
+                rightmost = target;
             target->value = std::move(successor->value); // swap successor and target
             parent = successor->parent; // we will delete successor's node
+            from_left = successor->is_left();
             // move successor->right subtree up
             if (successor->right)
                 successor->right->diff += successor->diff; // diff are relative to parent, that's why we're changing it
@@ -194,101 +656,681 @@ public:
 
             target = successor; // trick to free right memory
         }
-        this->_allocator.deallocate(target, 1);
+        destroy_node(target);
         if (not parent) // means root is deleted
             return; // don't need to fix anything if root is deleted (parent is successor's parent)
         else {
-            parent->fix_height();
-            fix(parent);
+            parent->pull_path();
+            if (NodePtr top = Balance::erased(parent, from_left, _stats))
+                root = top;
         }
     }
 
+    // add delta to indices of all nodes after node, and to node itself if with_node, O(depth of node)
+    // only nodes on the path to root change their diffs, other subtrees move together with them
+    void shift(NodePtr node, bool with_node, long delta){
+        if (with_node){
+            if (node->left)
+                node->left->diff -= delta; // left subtree stays
+        } else if (node->right)
+            node->right->diff += delta;
+        bool shifted = with_node;
+        for (; node->parent; node = node->parent){
+            bool parent_shifted = node->is_left(); // parent is after node's subtree
+            node->diff += delta * (long(shifted) - long(parent_shifted));
+            shifted = parent_shifted;
+        }
+        if (shifted)
+            node->diff += delta; // root's diff is its index
+    }
+
+    // remembers node and its index, so nearby positions are reached in O(log distance)
+    // instead of descending from root every time
+    // stays valid through its own insert and remove, any other modification of the list invalidates it
+    class Cursor {
+        friend class TreeList;
+        TreeList* list;
+        NodePtr node; // nullptr at end
+        unsigned long position;
+
+        Cursor(TreeList* list, NodePtr node, unsigned long position) : list(list), node(node), position(position) {}
+    public:
+        unsigned long index() const noexcept { return position; }
+        bool at_end() const noexcept { return not node; }
+        element_type& operator*() const { return node->value; }
+        element_type* operator->() const { return &node->value; }
+
+        // climbs to common ancestor of both positions and descends from there
+        // positions after the last element give end
+        Cursor& move_to(unsigned long index){
+            if (index == position)
+                return *this;
+            long offset = long(index) - long(position);
+            if (not node){ // the only way from end is through the last node
+                if (not list->root)
+                    return *this;
+                node = list->root->max();
+                ++offset;
+            }
+            node = node->relative(offset);
+            position = node ? index : list->_size;
+            return *this;
+        }
+
+        Cursor& operator+=(long offset) { return move_to(position + offset); }
+        Cursor& operator-=(long offset) { return move_to(position - offset); }
+        Cursor& operator++() { node = node->next(); ++position; return *this; }
+        Cursor& operator--() { node = node ? node->prev() : list->root->max(); --position; return *this; }
+
+        // insert value before cursor, cursor points to it afterwards
+        // doesn't descend from root, only climbs from cursor to update indices and rebalance
+        void insert(const T& value){
+            if (not node){
+                list->push_back(value);
+                node = list->root->max();
+                return;
+            }
+            node->push();
+            list->shift(node, true, 1);
+            NodePtr created, parent;
+            ++list->_size;
+            if (not node->left){
+                created = list->create_node(-1, value);
+                parent = node;
+                parent->make_left(created);
+            } else {
+                parent = node->left->max();
+                created = list->create_node(1, value);
+                parent->make_right(created);
+            }
+            list->attached(created, position);
+            created->pull_path();
+            list->fix(parent);
+            node = created;
+        }
+
+        // remove value at cursor, cursor points to the next one afterwards
+        void remove(){
+            assert(node);
+            node->push();
+            // with two children, successor's value moves into node and successor is destroyed
+            NodePtr next = node->left and node->right ? node : node->next();
+            list->shift(node, false, -1);
+            list->erase_node(node);
+            node = next;
+        }
+    };
+
+    // cursor at index, end if there is no such index
+    Cursor cursor(unsigned long index = 0){
+        NodePtr node = get_node(index);
+        return Cursor(this, node, node ? index : _size);
+    }
+
     // Node at index, nullptr if not exist
     NodePtr get_node(unsigned long index) const {
         if (not root) return nullptr;
         NodePtr current = root;
-        unsigned long current_index = current->diff;
+        unsigned long current_index = current->diff, depth = 1;
         while (true){
+            current->push();
             if (current_index == index)
-                return current;
+                break;
             if (index < current_index) {
                 assert(current->left); // we're implementing a list, not a dictionary
                 current = current->left;
             } else { // index > current_index
-                if (not current->right)
-                    return nullptr;
+                if (not current->right) {
+                    current = nullptr;
+                    break;
+                }
                 current = current->right;
             }
             current_index += current->diff;
+            ++depth;
         }
+        _stats.descent(depth);
+        return current;
     }
 
-    T& operator[](unsigned long index) const {
+    element_type& operator[](unsigned long index) const {
         return get_node(index)->value;
     }
 
-    T& at(unsigned long index) const {
+    element_type& at(unsigned long index) const {
         NodePtr node = get_node(index);
         if (node)
             return node->value;
         throw std::out_of_range(std::to_string(index) + " is out of range");
     }
 
-    void push_back(const T& value){
-        if (root == nullptr){
-            root = this->_allocator.allocate(1);
-            new (root) NodeType(0, value);
+    // assign value at index keeping aggregates and index correct
+    // changing values through references doesn't update aggregates
+    void set(unsigned long index, const T& value){
+        NodePtr node = get_node(index);
+        if (not node)
+            throw std::out_of_range(std::to_string(index) + " is out of range");
+        _index.erase(node->value, node);
+        node->value = value;
+        _index.insert(node->value, node);
+        node->pull_path();
+    }
+
+    // index of some element equal to value, size() if there is none, O(log n) with HashIndex
+    unsigned long find(const T& value) const {
+        static_assert(Index::enabled, "find needs Index");
+        auto [first, last] = _index.equal_range(value);
+        if (first == last)
+            return _size;
+        return static_cast<const NodeType*>(first->second)->index();
+    }
+
+    // indices of all elements equal to value in increasing order, O(k log n) for k of them
+    std::vector<unsigned long> find_all(const T& value) const {
+        static_assert(Index::enabled, "find_all needs Index");
+        std::vector<unsigned long> result;
+        auto [first, last] = _index.equal_range(value);
+        for (; first != last; ++first)
+            result.push_back(static_cast<const NodeType*>(first->second)->index());
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+
+    // aggregate of [first, last), O(log n)
+    auto reduce(unsigned long first, unsigned long last) const {
+        static_assert(NodeType::augmented, "reduce needs Augment");
+        if (not root)
+            return Augment::identity();
+        return reduce(root, root->diff, 0, _size, first, last);
+    }
+
+    // aggregate of subtree covering [begin, end), node is at index
+    static auto reduce(NodePtr node, unsigned long index, unsigned long begin, unsigned long end,
+                       unsigned long first, unsigned long last){
+        if (not node or last <= begin or end <= first)
+            return Augment::identity();
+        if (first <= begin and end <= last)
+            return node->aggregate;
+        node->push();
+        typename Augment::value_type result = first <= index and index < last ? Augment::lift(node->value)
+                                                                                : Augment::identity();
+        if (node->left)
+            result = Augment::combine(reduce(node->left, index + node->left->diff, begin, index, first, last), result);
+        if (node->right)
+            result = Augment::combine(result, reduce(node->right, index + node->right->diff, index + 1, end, first, last));
+        return result;
+    }
+
+    // apply tag to every element of [first, last), O(log n)
+    // whole subtrees get the tag lazily, it reaches their nodes when they are visited
+    template <class Tag>
+    void apply(unsigned long first, unsigned long last, const Tag& tag){
+        static_assert(NodeType::lazy, "apply needs Augment with tag_type");
+        if (root)
+            apply(root, root->diff, 0, _size, first, last, tag);
+    }
+
+    // subtree covers [begin, end), node is at index
+    template <class Tag>
+    static void apply(NodePtr node, unsigned long index, unsigned long begin, unsigned long end,
+                      unsigned long first, unsigned long last, const Tag& tag){
+        if (not node or last <= begin or end <= first)
+            return;
+        if (first <= begin and end <= last)
+            return node->apply(tag);
+        node->push();
+        if (first <= index and index < last)
+            Augment::apply(tag, node->value);
+        if (node->left)
+            apply(node->left, index + node->left->diff, begin, index, first, last, tag);
+        if (node->right)
+            apply(node->right, index + node->right->diff, index + 1, end, first, last, tag);
+        node->pull();
+    }
+
+    // reverse order of [first, last), O(log n)
+    // range is split out, its root gets mirrored index and reversal flag, then it's joined back
+    void reverse(unsigned long first, unsigned long last){
+        static_assert(NodeType::reversible, "reverse needs Augment with reversible = true");
+        last = std::min(last, _size);
+        if (first + 1 >= last)
             return;
+        auto [rest, after] = split(root, _size, last);
+        auto [before, middle] = split(rest, last, first);
+        middle->diff = last - first - 1 - middle->diff;
+        middle->reverse();
+        root = concat(concat(before, first, middle), last, after);
+        find_ends();
+    }
+
+    // in-order iterator, walks through parent links instead of descending from root
+    // end() is represented by nullptr node
+    template <class value_t>
+    class Iterator {
+        friend class TreeList;
+        template <class> friend class Iterator;
+        NodePtr node = nullptr;
+        const TreeList* list = nullptr;
+
+        Iterator(NodePtr node, const TreeList* list) : node(node), list(list) {}
+
+        // index of node, end() has index of last + 1
+        long position() const noexcept {
+            if (node)
+                return node->index();
+            return list->_size;
         }
+    public:
+        typedef std::random_access_iterator_tag iterator_category;
+        typedef std::remove_const_t<value_t> value_type;
+        typedef long difference_type;
+        typedef value_t* pointer;
+        typedef value_t& reference;
 
-        // find last element
-        NodePtr current = root;
-        while (current->right)
-            current = current->right;
+        Iterator() = default;
 
-        NodePtr node = this->_allocator.allocate(1);
-        new (node) NodeType(1, value);
+        // iterator -> const_iterator
+        template <class other_t, class = std::enable_if_t<std::is_const_v<value_t> and not std::is_const_v<other_t>>>
+        Iterator(const Iterator<other_t>& other) : node(other.node), list(other.list) {}
+
+        reference operator*() const { return node->value; }
+        pointer operator->() const { return &node->value; }
+        reference operator[](difference_type offset) const { return *(*this + offset); }
+
+        Iterator& operator++() {
+            node = node->next();
+            return *this;
+        }
+
+        Iterator& operator--() {
+            node = node ? node->prev() : list->root->max();
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator copy = *this;
+            ++*this;
+            return copy;
+        }
+
+        Iterator operator--(int) {
+            Iterator copy = *this;
+            --*this;
+            return copy;
+        }
+
+        // O(log offset), going past the last node gives end()
+        Iterator& operator+=(difference_type offset) {
+            if (offset == 0)
+                return *this;
+            if (not node) { // the only way from end() is through the last node
+                node = list->root->max();
+                ++offset;
+            }
+            if (offset == 1)
+                node = node->next();
+            else if (offset == -1)
+                node = node->prev();
+            else if (offset != 0)
+                node = node->relative(offset);
+            return *this;
+        }
+
+        Iterator& operator-=(difference_type offset) { return *this += -offset; }
+        Iterator operator+(difference_type offset) const { return Iterator(*this) += offset; }
+        Iterator operator-(difference_type offset) const { return Iterator(*this) -= offset; }
+        friend Iterator operator+(difference_type offset, const Iterator& it) { return it + offset; }
+
+        template <class other_t>
+        difference_type operator-(const Iterator<other_t>& other) const {
+            return position() - other.position();
+        }
+
+        template <class other_t>
+        bool operator==(const Iterator<other_t>& other) const noexcept { return node == other.node; }
+        template <class other_t>
+        bool operator!=(const Iterator<other_t>& other) const noexcept { return node != other.node; }
+        template <class other_t>
+        bool operator<(const Iterator<other_t>& other) const { return *this - other < 0; }
+        template <class other_t>
+        bool operator>(const Iterator<other_t>& other) const { return *this - other > 0; }
+        template <class other_t>
+        bool operator<=(const Iterator<other_t>& other) const { return *this - other <= 0; }
+        template <class other_t>
+        bool operator>=(const Iterator<other_t>& other) const { return *this - other >= 0; }
+    };
+
+    typedef Iterator<element_type> iterator;
+    typedef Iterator<const T> const_iterator;
+    typedef std::reverse_iterator<iterator> reverse_iterator;
+    typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+    iterator begin() { return iterator(root ? root->min() : nullptr, this); }
+    iterator end() { return iterator(nullptr, this); }
+    const_iterator begin() const { return const_iterator(root ? root->min() : nullptr, this); }
+    const_iterator end() const { return const_iterator(nullptr, this); }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+
+    reverse_iterator rbegin() { return reverse_iterator(end()); }
+    reverse_iterator rend() { return reverse_iterator(begin()); }
+    const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+    const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+    const_reverse_iterator crbegin() const { return rbegin(); }
+    const_reverse_iterator crend() const { return rend(); }
+
+    void push_back(const T& value){
+        emplace_back(value);
+    }
+
+    void push_back(T&& value){
+        emplace_back(std::move(value));
+    }
+
+    template <class... Args>
+    element_type& emplace_back(Args&&... args){
+        NodePtr node = create_node(1, std::forward<Args>(args)...);
+        ++_size;
+        if (root == nullptr){
+            node->diff = 0;
+            root = leftmost = rightmost = node;
+            return node->value;
+        }
+
+        NodePtr current;
+        if constexpr (cache_ends)
+            current = rightmost;
+        else
+            current = root->max(); // find last element
         current->make_right(node);
+        rightmost = node;
+        node->pull_path();
+        fix(current);
+        return node->value;
+    }
+
+    void push_front(const T& value){
+        emplace_front(value);
+    }
+
+    void push_front(T&& value){
+        emplace_front(std::move(value));
+    }
+
+    // O(1) amortized besides rebalancing: everything moves right by one, but only root's diff is absolute
+    template <class... Args>
+    element_type& emplace_front(Args&&... args){
+        if constexpr (not cache_ends)
+            return emplace(0, std::forward<Args>(args)...);
+        NodePtr node = create_node(-1, std::forward<Args>(args)...);
+        ++_size;
+        if (root == nullptr){
+            node->diff = 0;
+            root = leftmost = rightmost = node;
+            return node->value;
+        }
+        ++root->diff;
+        NodePtr current = leftmost;
+        current->make_left(node);
+        leftmost = node;
+        node->pull_path();
         fix(current);
+        return node->value;
+    }
+
+    // do nothing if list is empty
+    void pop_front(){
+        if constexpr (not cache_ends) {
+            remove(0);
+            return;
+        }
+        if (not root)
+            return;
+        NodePtr target = leftmost;
+        if (target != root)
+            --root->diff; // everything moves left by one, target is left alone, it is removed anyway
+        else if (target->right)
+            --target->right->diff; // root has no left half, right half moves left
+        erase_node(target);
+    }
+
+    void pop_back(){
+        if constexpr (not cache_ends) {
+            if (root)
+                remove(_size - 1);
+            return;
+        }
+        if (root) // nothing moves
+            erase_node(rightmost);
+    }
+
+    // list must not be empty
+    element_type& front() const {
+        assert(root);
+        if constexpr (cache_ends)
+            return leftmost->value;
+        return root->min()->value;
+    }
 
+    element_type& back() const {
+        assert(root);
+        if constexpr (cache_ends)
+            return rightmost->value;
+        return root->max()->value;
     }
 
-    // accepts parent of inserted/deleted node
-    // assumes correct height of node and unfixed height of it's parent
+    // number of elements, O(1)
+    unsigned long size() const noexcept { return _size; }
+    bool empty() const noexcept { return not root; }
+
+    // counters of Stats policy, they are not copied or swapped with the elements
+    const Stats& stats() const noexcept { return _stats; }
+
+    // accepts parent of inserted node
     void fix(NodePtr node){
-        long slope = node->slope();
-        do {
-            assert(slope == 2 or slope == -2 or slope == 1 or slope == -1 or slope == 0);
-            if (slope == 2){
-                if (node->right->slope() < 0) // == -1, left-heavy,
-                    node->right->right_rotate(); // change zig-zag path to zig-zig, not zag-zig
-                node->left_rotate();
-                node = node->parent; // rotation moved node down
-            } else if (slope == -2){
-                if (node->left->slope() > 0)
-                    node->left->left_rotate();
-                node->right_rotate();
-                node = node->parent;
+        if (NodePtr top = Balance::inserted(node, _stats))
+            root = top;
+    }
+
+    // number of elements in detached tree, root's diff is its index
+    static unsigned long count(NodePtr root) noexcept {
+        if (not root)
+            return 0;
+        unsigned long last = 0;
+        for (NodePtr current = root; current; current = current->right) {
+            current->push();
+            last += current->diff;
+        }
+        return last + 1;
+    }
+
+    // detached tree of left, mid and right in this order, O(|height(left) - height(right)|)
+    // left and right are detached trees, their roots' diffs are their indices
+    // mid is a single node, that is not linked to anything
+    NodePtr join(NodePtr left, unsigned long left_size, NodePtr mid, NodePtr right){
+        unsigned long left_height = left ? left->height : 0, right_height = right ? right->height : 0;
+        if (left_height <= right_height + 1 and right_height <= left_height + 1){
+            mid->diff = left_size;
+            if (left){
+                left->diff -= left_size;
+                mid->make_left(left);
             }
+            if (right){
+                right->diff += 1;
+                mid->make_right(right);
+            }
+            mid->fix_height();
+            mid->pull();
+            return mid;
+        }
 
-            if (not node->parent){ // root is rotated down
-                root = node;
-                break;
+        // mid goes down the spine of the higher tree, to the subtree of similar height
+        NodePtr current, parent = nullptr;
+        long index, parent_index = 0; // inside the higher tree
+        if (left_height > right_height){
+            current = left;
+            index = left->diff;
+            while (current and current->height > right_height + 1){
+                current->push();
+                parent = current;
+                parent_index = index;
+                current = current->right;
+                if (current)
+                    index += current->diff;
+            }
+            mid->diff = left_size - parent_index;
+            if (current){
+                current->diff = index - left_size;
+                current->set_parent_son(mid);
+                mid->make_left(current);
+            } else {
+                parent->make_right(mid);
+            }
+            if (right){
+                right->diff += 1;
+                mid->make_right(right);
+            }
+        } else {
+            current = right;
+            index = right->diff;
+            while (current and current->height > left_height + 1){
+                current->push();
+                parent = current;
+                parent_index = index;
+                current = current->left;
+                if (current)
+                    index += current->diff;
+            }
+            right->diff += left_size + 1; // whole right tree goes after left and mid
+            mid->diff = -parent_index - 1;
+            if (current){
+                current->diff = index + 1;
+                current->set_parent_son(mid);
+                mid->make_right(current);
+            } else {
+                parent->make_left(mid);
             }
-            node = node->parent;
-            node->fix_height(); // rotations doesn't change upper heights
-            slope = node->slope();
-        } while (node->bad_slope() or (node->parent and
-                (not node->parent->height_is_correct() or node->parent->bad_slope())));
+            if (left){
+                left->diff -= left_size;
+                mid->make_left(left);
+            }
+        }
+        mid->fix_height();
+        mid->pull_path();
+        NodePtr top = Balance::inserted(parent, _stats); // same as if mid was inserted
+
+        return top ? top : (left_height > right_height ? left : right);
     }
 
+    // detach children of node, making them separate trees
+    static std::pair<NodePtr, NodePtr> cut(NodePtr node){
+        node->push();
+        NodePtr left = node->left, right = node->right;
+        if (left){
+            left->diff += node->diff; // left subtree starts at index 0 as node's subtree
+            left->parent = nullptr;
+        }
+        if (right){
+            right->diff -= 1; // right subtree starts right after node
+            right->parent = nullptr;
+        }
+        node->left = node->right = nullptr;
+        node->height = 1;
+        node->pull();
+        return {left, right};
+    }
+
+    // split detached tree of size elements into [0, index) and [index, size), O(log size)
+    std::pair<NodePtr, NodePtr> split(NodePtr node, unsigned long size, unsigned long index){
+        if (not node)
+            return {nullptr, nullptr};
+        unsigned long node_index = node->diff;
+        auto [left, right] = cut(node);
+        if (index <= node_index){
+            auto [first, second] = split(left, node_index, index);
+            return {first, join(second, node_index - index, node, right)};
+        } else {
+            auto [first, second] = split(right, size - node_index - 1, index - node_index - 1);
+            return {join(left, node_index, node, first), second};
+        }
+    }
+
+    // unlink first node from detached tree without destroying it
+    NodePtr detach_first(NodePtr& tree){
+        NodePtr node = tree->min();
+        NodePtr parent = node->parent;
+        if (node->right)
+            node->right->diff += node->diff;
+        if (node == tree)
+            tree = node->right;
+        node->set_parent_son(node->right);
+        if (tree)
+            --tree->diff; // everything moves one position left
+        if (parent){
+            parent->pull_path();
+            if (NodePtr top = Balance::erased(parent, true, _stats))
+                tree = top;
+        }
+        node->right = node->parent = nullptr;
+        node->height = 1;
+        node->pull();
+        return node;
+    }
+
+    // detached tree of left followed by right
+    NodePtr concat(NodePtr left, unsigned long left_size, NodePtr right){
+        if (not right)
+            return left;
+        NodePtr mid = detach_first(right);
+        return join(left, left_size, mid, right);
+    }
+
+    // this keeps [0, index), returned list gets [index, end), O(log n)
+    TreeList split(unsigned long index){
+        static_assert(not Index::enabled, "index entries can't follow nodes to other list in O(log n)");
+        TreeList result;
+        result._allocator = _allocator; // nodes must be freed by the allocator that made them
+        index = std::min(index, _size);
+        auto [first, second] = split(root, _size, index);
+        root = first;
+        result.root = second;
+        result._size = _size - index;
+        _size = index;
+        find_ends();
+        result.find_ends();
+        return result;
+    }
+
+    // move all elements of other to the end of this list, O(log n)
+    // lists with allocators that can't free each other's nodes are merged element by element
+    void concat(TreeList& other){
+        static_assert(not Index::enabled, "index entries can't follow nodes to other list in O(log n)");
+        if (not other.root)
+            return;
+        if (not (_allocator == other._allocator)){
+            for (const T& value : other)
+                push_back(value);
+            other.clear();
+            return;
+        }
+        root = concat(root, _size, other.root);
+        _size += other._size;
+        other.root = nullptr;
+        other._size = 0;
+        other.leftmost = other.rightmost = nullptr;
+        find_ends();
+    }
+
+    void concat(TreeList&& other){
+        concat(other);
+    }
 };
 
 // output mermaid graph
 // each node has index, height, value
-template <class T, class stream_t>
-stream_t& operator << (stream_t& stream, TreeList<T>& tree){
-    typedef typename TreeList<T>::NodePtr Nodeptr;
+template <class stream_t, class T, class... Policies>
+stream_t& operator << (stream_t& stream, TreeList<T, Policies...>& tree){
+    typedef typename TreeList<T, Policies...>::NodePtr Nodeptr;
     if (not tree.root) return stream;
 
     std::stack<Nodeptr> stack;
@@ -306,7 +1348,7 @@ stream_t& operator << (stream_t& stream, TreeList<T>& tree){
         stack.pop();
         current_index = indices.top();
         indices.pop();
-        stream << current << "((" << current_index << ", " << current->height
+        stream << current << "((" << current_index << ", " << static_cast<unsigned long>(current->height)
                << ", " << current->value << "))\n";
         if (current->right) {
           indices.push(current_index + current->right->diff);
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+
+// Stats policy of TreeList counts internal work, so costs of workloads can be compared
+// NoStats, the default, has empty inline hooks and takes no space, so it costs nothing
+// custom policy has to provide the same hooks
+
+struct NoStats {
+    void rotation() noexcept {}
+    void rebalance(unsigned long) noexcept {}
+    void descent(unsigned long) noexcept {}
+    void successor(unsigned long) noexcept {}
+    void allocation() noexcept {}
+    void deallocation() noexcept {}
+};
+
+// number of events with each value, values above the last bucket go to the last bucket
+struct Histogram {
+    std::array<unsigned long, 64> buckets{};
+
+    void add(unsigned long value) noexcept {
+        ++buckets[value < buckets.size() ? value : buckets.size() - 1];
+    }
+
+    unsigned long count() const noexcept {
+        unsigned long result = 0;
+        for (unsigned long bucket : buckets)
+            result += bucket;
+        return result;
+    }
+
+    unsigned long total() const noexcept {
+        unsigned long result = 0;
+        for (unsigned long value = 0; value < buckets.size(); ++value)
+            result += value * buckets[value];
+        return result;
+    }
+
+    double mean() const noexcept {
+        unsigned long events = count();
+        return events ? double(total()) / events : 0;
+    }
+};
+
+struct CountingStats {
+    unsigned long rotations = 0; // single rotations, double rotation counts as two
+    Histogram rebalance_steps; // nodes visited by each rebalancing walk up
+    Histogram descent_depths; // nodes visited by get_node, insert and move_left
+    Histogram successor_depths; // nodes between removed node and its successor
+    unsigned long allocations = 0, deallocations = 0;
+
+    void rotation() noexcept { ++rotations; }
+    void rebalance(unsigned long steps) noexcept { rebalance_steps.add(steps); }
+    void descent(unsigned long depth) noexcept { descent_depths.add(depth); }
+    void successor(unsigned long depth) noexcept { successor_depths.add(depth); }
+    void allocation() noexcept { ++allocations; }
+    void deallocation() noexcept { ++deallocations; }
+};
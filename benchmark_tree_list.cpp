@@ -0,0 +1,376 @@
+// benchmarks for TreeList
+#include <benchmark/benchmark.h>
+
+#include "TreeList.h"
+#include "PoolAllocator.h"
+#include "ArenaAllocator.h"
+#include "ChunkList.h"
+#include "ConcurrentTreeList.h"
+#include "ParallelAlgorithms.h"
+#include "SortedTreeList.h"
+#include "FrozenTreeList.h"
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef TreeList<int> DefaultList;
+typedef TreeList<int, PoolAllocator<Node<int>>> PoolList;
+typedef TreeList<int, ArenaAllocator<int>, CompactLayout> CompactList;
+typedef TreeList<int, std::allocator<int>, PointerLayout, NoAugment, NoStats, NoIndex, WavlBalance> WavlList;
+typedef ChunkList<int> BlockList;
+
+// TreeList behind one coarse mutex, baseline for ConcurrentTreeList
+class LockedList {
+    TreeList<int> list;
+    mutable std::mutex mutex;
+public:
+    void push_back(int value){
+        std::lock_guard<std::mutex> guard(mutex);
+        list.push_back(value);
+    }
+    void insert(unsigned long index, int value){
+        std::lock_guard<std::mutex> guard(mutex);
+        list.insert(index, value);
+    }
+    void remove(unsigned long index){
+        std::lock_guard<std::mutex> guard(mutex);
+        list.remove(index);
+    }
+    int at(unsigned long index) const {
+        std::lock_guard<std::mutex> guard(mutex);
+        return list.at(index);
+    }
+};
+
+// TreeList's interface for std::vector and std::deque
+template <class Container>
+class StdList {
+    Container items;
+public:
+    void push_back(int value){ items.push_back(value); }
+    void insert(unsigned long index, int value){ items.insert(items.begin() + index, value); }
+    void remove(unsigned long index){ items.erase(items.begin() + index); }
+    int& at(unsigned long index){ return items.at(index); }
+    void set(unsigned long index, int value){ items.at(index) = value; }
+    unsigned long size() const { return items.size(); }
+    auto begin() const { return items.begin(); }
+    auto end() const { return items.end(); }
+};
+
+typedef StdList<std::vector<int>> VectorList;
+typedef StdList<std::deque<int>> DequeList;
+
+// lists without set() are changed through reference
+template <class List>
+void set(List& list, unsigned long index, int value){
+    if constexpr (requires { list.set(index, value); })
+        list.set(index, value);
+    else
+        list.at(index) = value;
+}
+
+template <class List>
+List make_list(long size){
+    List list;
+    for (long i = 0; i < size; ++i)
+        list.push_back(i);
+    return list;
+}
+
+enum class Access { uniform, front, back, sequential, zipf };
+
+const char* access_names[] = {"uniform", "front", "back", "sequential", "zipf"};
+
+// positions in [0, size) with given access pattern, computed before timing and then repeated
+std::vector<unsigned long> make_positions(Access access, unsigned long size){
+    std::mt19937_64 random(0);
+    std::uniform_real_distribution<double> unit(0, 1);
+    std::vector<unsigned long> positions(1 << 16);
+    for (unsigned long i = 0; i < positions.size(); ++i){
+        double u = unit(random);
+        switch (access){
+            case Access::uniform: positions[i] = random() % size; break;
+            case Access::front: positions[i] = u * u * u * size; break; // density grows towards 0
+            case Access::back: positions[i] = size - 1 - (unsigned long)(u * u * u * size); break;
+            case Access::sequential: positions[i] = i % size; break;
+            case Access::zipf: positions[i] = std::pow(double(size), u) - 1; break; // log-uniform, Zipf with s = 1
+        }
+        positions[i] = std::min(positions[i], size - 1);
+    }
+    return positions;
+}
+
+// list keeps its size, every iteration removes element and inserts another one at the same position
+template <class List, Access access>
+void BM_insert_remove(benchmark::State& state){
+    long size = state.range(0);
+    List list = make_list<List>(size);
+    std::vector<unsigned long> positions = make_positions(access, size);
+    unsigned long i = 0;
+    for (auto _ : state) {
+        unsigned long index = positions[i++ & 0xffff];
+        list.remove(index);
+        list.insert(index, 0);
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+}
+
+template <class List, Access access>
+void BM_at(benchmark::State& state){
+    long size = state.range(0);
+    List list = make_list<List>(size);
+    std::vector<unsigned long> positions = make_positions(access, size);
+    unsigned long i = 0;
+    for (auto _ : state)
+        benchmark::DoNotOptimize(list.at(positions[i++ & 0xffff]));
+    state.SetItemsProcessed(state.iterations());
+}
+
+template <class List, Access access>
+void BM_set(benchmark::State& state){
+    long size = state.range(0);
+    List list = make_list<List>(size);
+    std::vector<unsigned long> positions = make_positions(access, size);
+    unsigned long i = 0;
+    for (auto _ : state) {
+        set(list, positions[i & 0xffff], i);
+        ++i;
+    }
+    benchmark::DoNotOptimize(list.at(0));
+    state.SetItemsProcessed(state.iterations());
+}
+
+template <class List>
+void BM_push_back(benchmark::State& state){
+    for (auto _ : state) {
+        List list;
+        for (long i = 0; i < state.range(0); ++i)
+            list.push_back(i);
+        benchmark::DoNotOptimize(list.at(0));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// window of fixed size slides: append at the back, trim at the front
+template <class List>
+void BM_sliding_window(benchmark::State& state){
+    List list;
+    for (long i = 0; i < state.range(0); ++i)
+        list.push_back(i);
+    long i = 0;
+    for (auto _ : state) {
+        list.push_back(i++);
+        list.pop_front();
+    }
+    benchmark::DoNotOptimize(list.front());
+    state.SetItemsProcessed(state.iterations() * 2);
+}
+
+// build list by random insertions, then destroy it
+template <class List>
+void BM_build_and_clear(benchmark::State& state){
+    std::srand(0);
+    for (auto _ : state) {
+        List list;
+        for (long i = 0; i < state.range(0); ++i)
+            list.insert(std::rand() % (i + 1), i);
+        list.clear();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template <class List>
+void BM_scan(benchmark::State& state){
+    List list = make_list<List>(state.range(0));
+    for (auto _ : state) {
+        long sum = 0;
+        for (int value : list)
+            sum += value;
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// every operation with every access pattern on sizes from 1000 to max_size
+// names are operation/list/access, benchmark appends /size
+template <class List, Access access>
+void register_access(const std::string& list, long max_size){
+    std::string suffix = "/" + list + "/" + access_names[int(access)];
+    benchmark::RegisterBenchmark(("insert_remove" + suffix).c_str(), BM_insert_remove<List, access>)
+        ->RangeMultiplier(10)->Range(1000, max_size);
+    benchmark::RegisterBenchmark(("at" + suffix).c_str(), BM_at<List, access>)->RangeMultiplier(10)->Range(1000, max_size);
+    benchmark::RegisterBenchmark(("set" + suffix).c_str(), BM_set<List, access>)->RangeMultiplier(10)->Range(1000, max_size);
+}
+
+template <class List>
+void register_list(const std::string& list, long max_size){
+    benchmark::RegisterBenchmark(("push_back/" + list).c_str(), BM_push_back<List>)->RangeMultiplier(10)->Range(1000, max_size);
+    benchmark::RegisterBenchmark(("scan/" + list).c_str(), BM_scan<List>)->RangeMultiplier(10)->Range(1000, max_size);
+    register_access<List, Access::uniform>(list, max_size);
+    register_access<List, Access::front>(list, max_size);
+    register_access<List, Access::back>(list, max_size);
+    register_access<List, Access::sequential>(list, max_size);
+    register_access<List, Access::zipf>(list, max_size);
+}
+
+// k sorted random inserts into list of 100000 elements and k removals of them afterwards,
+// either one by one or with insert_batch and remove_batch
+template <bool batched>
+void BM_batch_edits(benchmark::State& state){
+    const long size = 100000, k = state.range(0);
+    DefaultList list = make_list<DefaultList>(size);
+    std::mt19937 random(0);
+    std::vector<std::pair<unsigned long, int>> inserts;
+    for (long i = 0; i < k; ++i)
+        inserts.emplace_back(random() % size, i);
+    std::sort(inserts.begin(), inserts.end());
+    std::vector<unsigned long> removes;
+    for (long i = 0; i < k; ++i)
+        removes.push_back(inserts[i].first + i); // where inserted values ended up
+    for (auto _ : state) {
+        if constexpr (batched) {
+            list.insert_batch(inserts);
+            list.remove_batch(removes);
+        } else {
+            for (long i = 0; i < k; ++i)
+                list.insert(inserts[i].first + i, inserts[i].second);
+            for (long i = k - 1; i >= 0; --i)
+                list.remove(removes[i]);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * k * 2);
+}
+
+// near-sequential access: position moves by a few elements, then element there is replaced
+// by remove and insert, either through indices or through cursor
+template <bool with_cursor>
+void BM_local_edits(benchmark::State& state){
+    long size = state.range(0);
+    DefaultList list = make_list<DefaultList>(size);
+    auto cursor = list.cursor(size / 2);
+    std::mt19937 random(0);
+    unsigned long index = size / 2;
+    for (auto _ : state) {
+        index = std::clamp<long>(long(index) + long(random() % 9) - 4, 0, size - 1);
+        if constexpr (with_cursor) {
+            cursor.move_to(index);
+            cursor.remove();
+            cursor.insert(0);
+        } else {
+            list.remove(index);
+            list.insert(index, 0);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+}
+
+// cheap function of every element, with iterator or with parallel_transform on shared pool
+template <bool parallel>
+void BM_transform(benchmark::State& state){
+    DefaultList list = make_list<DefaultList>(state.range(0));
+    for (auto _ : state) {
+        if constexpr (parallel)
+            parallel_transform(list, [](int value){ return value * 3 + 1; });
+        else
+            for (int& value : list)
+                value = value * 3 + 1;
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// searches in sorted list, by descending SortedTreeList or in its frozen Eytzinger index
+template <bool frozen>
+void BM_search(benchmark::State& state){
+    long size = state.range(0);
+    std::vector<int> values(size);
+    for (long i = 0; i < size; ++i)
+        values[i] = i * 2;
+    SortedTreeList<int> sorted(values.begin(), values.end());
+    FrozenTreeList<int> searchable = sorted.freeze();
+    std::mt19937 random(0);
+    for (auto _ : state) {
+        int value = random() % (size * 2);
+        if constexpr (frozen)
+            benchmark::DoNotOptimize(searchable.lower_bound(value));
+        else
+            benchmark::DoNotOptimize(sorted.rank(value));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// all threads share one list, every 10th operation removes random element and inserts another one
+// the rest read random elements, throughput is reported for every number of threads
+template <class List>
+void BM_concurrent(benchmark::State& state){
+    static List* list;
+    const long size = 100000, margin = 1024; // writers of other threads may shrink list for a moment
+    if (state.thread_index() == 0){
+        list = new List;
+        for (long i = 0; i < size; ++i)
+            list->push_back(i);
+    }
+    std::mt19937 random(state.thread_index());
+    for (auto _ : state) {
+        unsigned long index = random() % (size - margin);
+        if (index % 10 == 0) {
+            list->remove(index);
+            list->insert(index, 0);
+        } else
+            benchmark::DoNotOptimize(list->at(index));
+    }
+    if (state.thread_index() == 0)
+        delete list;
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_TEMPLATE(BM_build_and_clear, DefaultList)->RangeMultiplier(10)->Range(1000, 100000);
+BENCHMARK_TEMPLATE(BM_build_and_clear, PoolList)->RangeMultiplier(10)->Range(1000, 100000);
+BENCHMARK_TEMPLATE(BM_sliding_window, std::deque<int>)->RangeMultiplier(10)->Range(1000, 1000000);
+BENCHMARK_TEMPLATE(BM_sliding_window, DefaultList)->RangeMultiplier(10)->Range(1000, 1000000);
+BENCHMARK_TEMPLATE(BM_sliding_window, PoolList)->RangeMultiplier(10)->Range(1000, 1000000);
+BENCHMARK_TEMPLATE(BM_batch_edits, false)->RangeMultiplier(10)->Range(10, 100000);
+BENCHMARK_TEMPLATE(BM_batch_edits, true)->RangeMultiplier(10)->Range(10, 100000);
+BENCHMARK_TEMPLATE(BM_local_edits, false)->RangeMultiplier(10)->Range(1000, 1000000);
+BENCHMARK_TEMPLATE(BM_local_edits, true)->RangeMultiplier(10)->Range(1000, 1000000);
+BENCHMARK_TEMPLATE(BM_transform, false)->RangeMultiplier(10)->Range(10000, 1000000)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_transform, true)->RangeMultiplier(10)->Range(10000, 1000000)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_search, false)->RangeMultiplier(10)->Range(1000, 1000000);
+BENCHMARK_TEMPLATE(BM_search, true)->RangeMultiplier(10)->Range(1000, 1000000);
+BENCHMARK_TEMPLATE(BM_concurrent, LockedList)->ThreadRange(1, std::max(1u, std::thread::hardware_concurrency()))->UseRealTime();
+BENCHMARK_TEMPLATE(BM_concurrent, ConcurrentTreeList<int>)->ThreadRange(1, std::max(1u, std::thread::hardware_concurrency()))->UseRealTime();
+
+// all google benchmark flags work, --benchmark_out=results.json --benchmark_out_format=json gives input for speedgraph.py
+// --max_size=N sets largest list size, default 1e6, 1e8 needs several GiB of memory and a lot of time
+int main(int argc, char** argv){
+    long max_size = 1000000;
+    int kept = 1;
+    for (int i = 1; i < argc; ++i){
+        std::string argument = argv[i];
+        if (argument.rfind("--max_size=", 0) == 0)
+            max_size = std::stol(argument.substr(11));
+        else
+            argv[kept++] = argv[i];
+    }
+    argc = kept;
+
+    register_list<VectorList>("vector", max_size);
+    register_list<DequeList>("deque", max_size);
+    register_list<DefaultList>("tree", max_size);
+    register_list<WavlList>("tree_wavl", max_size);
+    register_list<PoolList>("tree_pool", max_size);
+    register_list<CompactList>("tree_compact", max_size);
+    register_list<BlockList>("chunk", max_size);
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+}
@@ -1,43 +1,51 @@
+import json
+import sys
+from collections import defaultdict
 from matplotlib import pyplot
-import numpy
 
-def get_valeus(filename):
-    X = []
-    Ys = []
-    with open(filename, 'rt') as file:
-        for line in file:
-            n, *rest = map(int, line.split())
-            X.append(n)
-            Ys.append(rest)
-    return X, list(zip(*Ys))
-
-# make line more smooth
-def get_avg(values, step):
-    return [numpy.mean(values[start:start+step]) for start in range(0, len(values), step)]
-
-
-operations = ['push_back', 'remove', 'insert', 'get', 'set']
-
-Xtree, Ytree = get_valeus('cmake-build-debug/results')
-Xvec, Yvec = get_valeus('cmake-build-debug/results-vec')
-
-for i in range(4):
-    pyplot.subplot(220 + i  + 1)
-    pyplot.plot(get_avg(Xtree, 10000), get_avg(Ytree[i], 10000), label='Tree ' + operations[i], color='g')
-    pyplot.plot(get_avg(Xvec, 10000), get_avg(Yvec[i], 10000), label='vector ' + operations[i], color='r')
+# plots JSON written by
+# tree_list_benchmark --benchmark_out=results.json --benchmark_out_format=json
+# usage: python3 speedgraph.py [results.json] [access pattern: uniform front back sequential zipf]
+
+filename = sys.argv[1] if len(sys.argv) > 1 else 'results.json'
+access = sys.argv[2] if len(sys.argv) > 2 else 'uniform'
+
+with open(filename, 'rt') as file:
+    benchmarks = json.load(file)['benchmarks']
+
+# operation -> list -> [(size, nanoseconds per item)]
+lines = defaultdict(lambda: defaultdict(list))
+for benchmark in benchmarks:
+    if benchmark.get('run_type') == 'aggregate':
+        continue
+    # drop options google benchmark appends, like real_time or threads:4
+    parts = [part for part in benchmark['name'].split('/')
+             if part != 'real_time' and part.split(':')[0] not in ('threads', 'min_time', 'iterations', 'repeats')]
+    if not parts[-1].isdigit() or 'items_per_second' not in benchmark:
+        continue
+    if len(parts) == 3: # operation/list/size
+        operation, container, size = parts
+    elif len(parts) == 4 and parts[2] == access: # operation/list/access/size
+        operation, container, _, size = parts
+    else:
+        continue
+    nanoseconds = 1e9 / benchmark['items_per_second']
+    lines[operation][container].append((int(size), nanoseconds))
+
+operations = sorted(lines)
+columns = 2
+rows = (len(operations) + columns - 1) // columns
+for i, operation in enumerate(operations):
+    pyplot.subplot(rows, columns, i + 1)
+    for container, points in sorted(lines[operation].items()):
+        points.sort()
+        pyplot.plot([size for size, _ in points], [time for _, time in points], marker='o', label=container)
+    pyplot.title(operation if operation in ('push_back', 'scan') else operation + ', ' + access)
+    pyplot.xscale('log')
+    pyplot.yscale('log')
     pyplot.xlabel("Number of elements")
-    pyplot.ylabel("time, nanoseconds")
+    pyplot.ylabel("time per element, nanoseconds")
     pyplot.legend()
 
-# pyplot.subplot(221)
-# pyplot.plot(get_avg(Xtree, 10000), get_avg(Ytree[2], 10000), label='Tree ' + operations[2], color='g')
-# pyplot.plot(get_avg(Xvec, 10000), get_avg(Yvec[2], 10000), label='vector ' + operations[2], color='r')
-#
-# pyplot.subplot(222)
-# pyplot.plot(get_avg(Xtree, 10000), get_avg(Ytree[1], 10000), label='Tree', color='g')
-# pyplot.plot(get_avg(Xvec, 10000), get_avg(Yvec[1], 10000), label='vector', color='r')
-
-
-
-
+pyplot.tight_layout()
 pyplot.show()
@@ -2,10 +2,41 @@
 #include <gtest/gtest.h>
 
 #include "TreeList.h"
+#include "PoolAllocator.h"
+#include "ArenaAllocator.h"
+#include "ChunkList.h"
+#include "PersistentTreeList.h"
+#include "ConcurrentTreeList.h"
+#include "ParallelAlgorithms.h"
+#include "MappedTreeList.h"
+#include "SortedTreeList.h"
+#include "FrozenTreeList.h"
 #include <vector>
+#include <deque>
 #include <iostream>
 #include <fstream>
-#include <chrono> // for time measurement
+#include <sstream>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <cstdio>
+
+// copying negative value throws, live counts existing objects, so leaks are visible
+struct ThrowingCopy {
+    static inline std::atomic<long> live{0};
+    int value;
+    ThrowingCopy(int value = 0) : value(value) { ++live; }
+    ThrowingCopy(const ThrowingCopy& other) : value(other.value) {
+        if (value < 0)
+            throw std::runtime_error("copy of negative value");
+        ++live;
+    }
+    ThrowingCopy& operator=(const ThrowingCopy&) = default;
+    ~ThrowingCopy() { --live; }
+    bool operator==(const ThrowingCopy& other) const { return value == other.value; }
+};
 
 TEST(TreeList_test, insertion){
     TreeList<unsigned long> list;
@@ -190,80 +221,1291 @@ TEST(TreeList_test, root_deletion){
     }
 }
 
-#define MEASURE_TIME(expr, result)\
-{\
-auto before = std::chrono::high_resolution_clock::now();\
-expr;\
-auto after = std::chrono::high_resolution_clock::now();\
-result = std::chrono::duration_cast<std::chrono::nanoseconds>(after-before).count();\
-}\
+TEST(TreeList_test, iteration){
+    TreeList<int> list;
+    std::vector<int> vec;
+    std::srand(0);
+    EXPECT_EQ(list.begin(), list.end());
+    for (int i = 0; i < 1000; ++i){
+        unsigned long index = std::rand() % (vec.size() + 1);
+        vec.insert(vec.begin() + index, i);
+        list.insert(index, i);
+    }
+
+    EXPECT_TRUE(std::equal(list.begin(), list.end(), vec.begin(), vec.end()));
+    EXPECT_TRUE(std::equal(list.rbegin(), list.rend(), vec.rbegin(), vec.rend()));
+    const TreeList<int>& const_list = list;
+    EXPECT_TRUE(std::equal(const_list.begin(), const_list.end(), vec.begin(), vec.end()));
+    EXPECT_EQ(list.end() - list.begin(), vec.size());
+
+    auto it = list.end();
+    for (auto vit = vec.end(); vit != vec.begin();)
+        EXPECT_EQ(*--it, *--vit);
+    EXPECT_EQ(it, list.begin());
+
+    // jumps in both directions
+    for (int i = 0; i < 1000; ++i){
+        long from = std::rand() % (vec.size() + 1), to = std::rand() % (vec.size() + 1);
+        auto jumped = list.begin() + from + (to - from);
+        EXPECT_EQ(jumped - list.begin(), to);
+        if (to < vec.size())
+            EXPECT_EQ(*jumped, vec[to]);
+        else
+            EXPECT_EQ(jumped, list.end());
+    }
+
+    *list.begin() = 12345;
+    EXPECT_EQ(list.at(0), 12345);
+}
+
+template <class List>
+void expect_balanced(const List& list){
+    for (auto node = list.root ? list.root->min() : nullptr; node; node = node->next())
+        EXPECT_TRUE(List::BalanceType::valid(node));
+    if constexpr (List::cache_ends) {
+        EXPECT_EQ(list.leftmost, list.root ? list.root->min() : nullptr);
+        EXPECT_EQ(list.rightmost, list.root ? list.root->max() : nullptr);
+    }
+}
+
+TEST(TreeList_test, bulk_construction){
+    for (int N : {0, 1, 2, 3, 7, 8, 100, 1023, 1024}) {
+        std::vector<int> vec(N);
+        for (int i = 0; i < N; ++i)
+            vec[i] = i * 3;
+
+        TreeList<int> list(vec.begin(), vec.end());
+        EXPECT_TRUE(std::equal(list.begin(), list.end(), vec.begin(), vec.end()));
+        for (int i = 0; i < N; ++i)
+            EXPECT_EQ(list.at(i), vec[i]);
+        expect_balanced(list);
+
+        TreeList<int> copy(list);
+        EXPECT_TRUE(std::equal(copy.begin(), copy.end(), vec.begin(), vec.end()));
+        expect_balanced(copy);
+        if (N) {
+            copy.insert(N / 2, -1);
+            copy.remove(0);
+            EXPECT_EQ(list.at(0), 0); // deep copy
+        }
+    }
+
+    std::istringstream stream("5 4 3 2 1");
+    TreeList<int> list = {9, 9};
+    list.assign(std::istream_iterator<int>(stream), std::istream_iterator<int>());
+    EXPECT_EQ(std::vector<int>(list.begin(), list.end()), std::vector<int>({5, 4, 3, 2, 1}));
+    list.push_back(0);
+    expect_balanced(list);
+
+    {
+        TreeList<ThrowingCopy> throwing;
+        for (int i = 0; i < 100; ++i)
+            throwing.emplace_back(i == 70 ? -1 : i); // constructed in place, copying it throws
+        EXPECT_THROW(TreeList<ThrowingCopy> copy(throwing), std::runtime_error);
+        EXPECT_EQ(ThrowingCopy::live, 100); // partial copy is destroyed
+    }
+    EXPECT_EQ(ThrowingCopy::live, 0);
+}
+
+TEST(TreeList_test, save_load){
+    for (int N : {0, 1, 5, 1000}) {
+        TreeList<int> list;
+        for (int i = 0; i < N; ++i)
+            list.insert(i / 2, i);
+        std::stringstream stream;
+        list.save(stream, 64);
+
+        TreeList<int> loaded = {7};
+        loaded.load(stream, 10); // chunks smaller than saved ones
+        EXPECT_TRUE(std::equal(list.begin(), list.end(), loaded.begin(), loaded.end()));
+        EXPECT_EQ(loaded.size(), N);
+        expect_balanced(loaded);
+        loaded.insert(0, -1);
+        expect_balanced(loaded);
+    }
+
+    TreeList<double> doubles = {1.5, 2.5, 3.5};
+    std::stringstream stream;
+    doubles.save(stream);
+    std::string bytes = stream.str();
+
+    TreeList<int> wrong_type;
+    std::stringstream copy(bytes);
+    EXPECT_THROW(wrong_type.load(copy), std::runtime_error);
+
+    std::stringstream truncated(bytes.substr(0, bytes.size() - 4));
+    EXPECT_THROW(doubles.load(truncated), std::runtime_error); // built part is freed
+    EXPECT_TRUE(doubles.empty());
+
+    std::stringstream garbage("not a list at all, definitely not");
+    EXPECT_THROW(doubles.load(garbage), std::runtime_error);
+}
+
+TEST(TreeList_test, destruction){
+    auto counter = std::make_shared<int>(0);
+    {
+        TreeList<std::shared_ptr<int>> list;
+        for (int i = 0; i < 1000; ++i)
+            list.insert(i / 2, counter);
+        EXPECT_EQ(counter.use_count(), 1001);
+
+        for (int i = 0; i < 500; ++i)
+            list.remove(std::rand() % (1000 - i));
+        EXPECT_EQ(counter.use_count(), 501);
+
+        TreeList<std::shared_ptr<int>> other(list);
+        EXPECT_EQ(counter.use_count(), 1001);
+        other = TreeList<std::shared_ptr<int>>{nullptr, nullptr}; // old nodes released right away
+        EXPECT_EQ(counter.use_count(), 501);
+
+        list.clear();
+        EXPECT_EQ(counter.use_count(), 1);
+        EXPECT_EQ(list.begin(), list.end());
+
+        for (int i = 0; i < 100; ++i)
+            list.push_back(counter);
+    }
+    EXPECT_EQ(counter.use_count(), 1);
+}
+
+TEST(TreeList_test, pool_allocator){
+    TreeList<std::string, PoolAllocator<Node<std::string>, 64>> list;
+    std::vector<std::string> vec;
+    std::srand(0);
+    for (int i = 0; i < 3000; ++i){
+        unsigned long index = std::rand() % (vec.size() + 1);
+        if (std::rand() % 3 == 0 and not vec.empty()) {
+            index %= vec.size();
+            vec.erase(vec.begin() + index);
+            list.remove(index);
+        } else {
+            vec.insert(vec.begin() + index, std::to_string(i));
+            list.insert(index, std::to_string(i));
+        }
+    }
+    EXPECT_TRUE(std::equal(list.begin(), list.end(), vec.begin(), vec.end()));
+    EXPECT_GT(list._allocator.slab_count(), 0);
+    EXPECT_LE(list._allocator.slab_count(), vec.size() / 64 + 1); // removed nodes are reused
+
+    auto copy = list;
+    EXPECT_TRUE(std::equal(copy.begin(), copy.end(), vec.begin(), vec.end()));
+    EXPECT_NE(copy._allocator, list._allocator);
+
+    list.clear();
+    EXPECT_EQ(list._allocator.slab_count(), 0);
+    list.push_back("again");
+    EXPECT_EQ(list.at(0), "again");
+
+    // rebound copies share pools
+    PoolAllocator<int> ints;
+    PoolAllocator<double> doubles(ints);
+    PoolAllocator<int> back(doubles);
+    EXPECT_EQ(back, ints);
+    EXPECT_EQ(doubles, ints);
+    int* value = back.allocate(1);
+    ints.deallocate(value, 1);
+    EXPECT_EQ(ints.allocate(1), value); // slot is recycled by equal allocator
+    double* other = doubles.allocate(1);
+    doubles.deallocate(other, 1);
+    ints.deallocate(value, 1);
+    EXPECT_EQ(ints.slab_count(), 1);
+    EXPECT_EQ(doubles.slab_count(), 1);
+
+    auto moved = std::move(copy); // allocator of moved from list stays usable
+    copy.push_back("moved from");
+    EXPECT_EQ(copy._allocator, moved._allocator);
+    EXPECT_TRUE(std::equal(moved.begin(), moved.end(), vec.begin(), vec.end()));
+}
+
+TEST(TreeList_test, compact_layout){
+    typedef TreeList<int, ArenaAllocator<int>, CompactLayout> CompactList;
+    static_assert(sizeof(CompactList::NodeType) <= 24);
+    static_assert(sizeof(CompactList::NodeType) * 2 <= sizeof(TreeList<int>::NodeType));
+
+    CompactList list;
+    std::vector<int> vec;
+    std::srand(0);
+    for (int i = 0; i < 3000; ++i){
+        unsigned long index = std::rand() % (vec.size() + 1);
+        if (std::rand() % 3 == 0 and not vec.empty()) {
+            index %= vec.size();
+            vec.erase(vec.begin() + index);
+            list.remove(index);
+        } else {
+            vec.insert(vec.begin() + index, i);
+            list.insert(index, i);
+        }
+    }
+    EXPECT_TRUE(std::equal(list.begin(), list.end(), vec.begin(), vec.end()));
+    for (int j = 0; j < vec.size(); ++j)
+        EXPECT_EQ(list.at(j), vec[j]);
+    expect_balanced(list);
+
+    CompactList copy(list);
+    EXPECT_TRUE(std::equal(copy.begin(), copy.end(), vec.begin(), vec.end()));
+    list.clear();
+    EXPECT_EQ(list._allocator.used(), 0);
+
+    // rebound copies share the region, it is reserved only when used
+    ArenaAllocator<int> ints;
+    ArenaAllocator<double> doubles(ints);
+    EXPECT_EQ(ArenaAllocator<int>(doubles), ints);
+    double* value = doubles.allocate(1);
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(value) % alignof(double), 0);
+    EXPECT_GT(ints.used(), 0);
+    doubles.deallocate(value, 1);
+    std::vector<CompactList> empty(100000); // 4GiB each would exhaust address space
+    CompactList moved(std::move(copy));
+    EXPECT_EQ(copy._allocator, moved._allocator);
+}
+
+TEST(TreeList_test, mapped_file){
+    std::string path = testing::TempDir() + "tree_list_mapped_test";
+    std::remove(path.c_str());
+    std::vector<int> vec;
+    {
+        MappedTreeList<int> list(path.c_str());
+        EXPECT_TRUE(list.empty());
+        std::srand(0);
+        for (int i = 0; i < 3000; ++i){
+            unsigned long index = std::rand() % (vec.size() + 1);
+            if (std::rand() % 3 == 0 and not vec.empty()) {
+                index %= vec.size();
+                vec.erase(vec.begin() + index);
+                list.remove(index);
+            } else {
+                vec.insert(vec.begin() + index, i);
+                list.insert(index, i);
+            }
+        }
+    }
+    for (int reopen = 0; reopen < 2; ++reopen) { // mapped anew each time, possibly at other address
+        MappedTreeList<int> list(path.c_str());
+        EXPECT_EQ(list.size(), vec.size());
+        EXPECT_TRUE(std::equal(list.begin(), list.end(), vec.begin(), vec.end()));
+        for (int j = 0; j < vec.size(); j += 7)
+            EXPECT_EQ(list.at(j), vec[j]);
+        expect_balanced(list);
+        list.insert(0, -reopen);
+        vec.insert(vec.begin(), -reopen);
+        list.remove(vec.size() / 2); // freed slot is found through the file's free list next time
+        vec.erase(vec.begin() + vec.size() / 2);
+    }
+
+    EXPECT_THROW(MappedTreeList<double>(path.c_str()), std::runtime_error); // other node size
+    EXPECT_THROW(MappedTreeList<float>(path.c_str()), std::runtime_error); // same size, other type
+    EXPECT_THROW(MappedTreeList<int>(testing::TempDir().c_str()), std::system_error); // directory can't be opened
+    std::remove(path.c_str());
+}
+
+// counts copies to check that values are moved or constructed in place
+struct Tracked {
+    static inline int copies = 0;
+    std::string text;
+    Tracked(std::string text) : text(std::move(text)) {}
+    Tracked(const char* text, int repeat) : text() { while (repeat--) this->text += text; }
+    Tracked(const Tracked& other) : text(other.text) { ++copies; }
+    Tracked(Tracked&&) = default;
+    Tracked& operator=(const Tracked& other) { text = other.text; ++copies; return *this; }
+    Tracked& operator=(Tracked&&) = default;
+};
+
+TEST(TreeList_test, move_and_emplace){
+    TreeList<Tracked> list;
+    list.push_back(Tracked("a"));
+    list.insert(0, Tracked("b"));
+    EXPECT_EQ(list.emplace(1, "c", 3).text, "ccc");
+    EXPECT_EQ(list.emplace_back("d", 2).text, "dd");
+    Tracked e("e");
+    list.insert(2, std::move(e));
+    for (int i = 0; i < 100; ++i)
+        list.emplace(i % 7, std::to_string(i));
+    EXPECT_EQ(Tracked::copies, 0);
+    EXPECT_EQ(list.size(), 105);
+    list.remove(0); // successor's value is moved into removed node
+    EXPECT_EQ(Tracked::copies, 0);
+    EXPECT_EQ(list.size(), 104);
+
+    TreeList<std::unique_ptr<int>> pointers;
+    pointers.push_back(std::make_unique<int>(1));
+    pointers.emplace(0, new int(0));
+    pointers.emplace_back();
+    EXPECT_EQ(*pointers.at(0), 0);
+    EXPECT_EQ(*pointers.at(1), 1);
+    EXPECT_EQ(pointers.at(2), nullptr);
+    EXPECT_EQ(pointers.size(), 3);
+    pointers.clear();
+    EXPECT_EQ(pointers.size(), 0);
+    EXPECT_TRUE(pointers.empty());
+}
+
+TEST(TreeList_test, stats){
+    static_assert(sizeof(TreeList<int>) == sizeof(TreeList<int, std::allocator<Node<int>>, PointerLayout, NoAugment, NoStats>));
+    TreeList<int, std::allocator<Node<int>>, PointerLayout, NoAugment, CountingStats> list;
+    for (int i = 0; i < 1000; ++i)
+        list.push_back(i);
+    const CountingStats& stats = list.stats();
+    EXPECT_EQ(stats.allocations, 1000);
+    EXPECT_EQ(stats.deallocations, 0);
+    EXPECT_GT(stats.rotations, 0);
+    EXPECT_EQ(stats.rebalance_steps.count(), 999); // first push_back has nothing to fix
+    EXPECT_EQ(stats.descent_depths.count(), 0); // push_back goes to the last node without index search
+
+    for (int i = 0; i < 100; ++i)
+        EXPECT_EQ(list.at(i * 7), i * 7);
+    EXPECT_EQ(stats.descent_depths.count(), 100);
+    EXPECT_LE(stats.descent_depths.mean(), 15); // ~log2(1000) for AVL
+
+    list.remove(list.root->diff); // root has both children, so its successor is found
+    EXPECT_EQ(stats.successor_depths.count(), 1);
+    EXPECT_GE(stats.successor_depths.total(), 1);
+    for (int i = 0; i < 500; ++i)
+        list.remove(i);
+    EXPECT_EQ(stats.allocations - stats.deallocations, list.size());
+    list.clear();
+    EXPECT_EQ(stats.allocations, stats.deallocations);
+}
+
+template <class List>
+void check_deque_ends(){
+    List list;
+    std::deque<int> reference;
+    std::srand(0);
+    for (int i = 0; i < 5000; ++i){
+        int action = std::rand() % 10;
+        if (action < 3) {
+            list.push_back(i);
+            reference.push_back(i);
+        } else if (action < 6) {
+            list.push_front(i);
+            reference.push_front(i);
+        } else if (action == 6) {
+            list.pop_front();
+            if (not reference.empty())
+                reference.pop_front();
+        } else if (action == 7) {
+            list.pop_back();
+            if (not reference.empty())
+                reference.pop_back();
+        } else if (action == 8) { // middle edits keep ends cached too
+            unsigned long index = std::rand() % (reference.size() + 1);
+            list.insert(index, i);
+            reference.insert(reference.begin() + index, i);
+        } else if (not reference.empty()) {
+            unsigned long index = std::rand() % reference.size();
+            list.remove(index);
+            reference.erase(reference.begin() + index);
+        }
+        EXPECT_EQ(list.size(), reference.size());
+        if (not reference.empty()) {
+            EXPECT_EQ(list.front(), reference.front());
+            EXPECT_EQ(list.back(), reference.back());
+        }
+        if (i % 500 == 0)
+            expect_balanced(list);
+    }
+    EXPECT_TRUE(std::equal(list.begin(), list.end(), reference.begin(), reference.end()));
+    for (unsigned long j = 0; j < reference.size(); j += 7)
+        EXPECT_EQ(list.at(j), reference[j]);
+    expect_balanced(list);
+    while (not list.empty())
+        list.pop_front();
+    list.pop_back(); // nothing to remove
+    list.push_front(1);
+    EXPECT_EQ(list.back(), 1);
+}
+
+TEST(TreeList_test, deque_ends){
+    check_deque_ends<TreeList<int>>();
+    check_deque_ends<TreeList<int, ArenaAllocator<int>, CompactLayout>>();
+    check_deque_ends<TreeList<int, std::allocator<int>, PointerLayout, ReverseAugment>>(); // no cached ends
+
+    TreeList<int> list = {1, 2, 3, 4, 5};
+    list.cursor(0).insert(0); // becomes front
+    list.cursor(6).insert(6); // end cursor, becomes back
+    EXPECT_EQ(list.front(), 0);
+    EXPECT_EQ(list.back(), 6);
+    TreeList<int> tail = list.split(3);
+    EXPECT_EQ(list.back(), 2);
+    EXPECT_EQ(tail.front(), 3);
+    tail.concat(list);
+    EXPECT_EQ(tail.back(), 2);
+    expect_balanced(tail);
+}
+
+TEST(TreeList_test, split_concat){
+    std::srand(0);
+    for (int N : {0, 1, 2, 5, 100, 1000}) {
+        std::vector<int> vec(N);
+        for (int i = 0; i < N; ++i)
+            vec[i] = i;
+        for (int attempt = 0; attempt < 20; ++attempt){
+            TreeList<int> list;
+            for (int i = 0; i < N; ++i) // not perfectly balanced
+                list.insert(std::rand() % (i + 1) == 0 ? 0 : i, i);
+            std::vector<int> expected(list.begin(), list.end());
+
+            unsigned long index = std::rand() % (N + 1);
+            TreeList<int> tail = list.split(index);
+            EXPECT_EQ(list.size(), index);
+            EXPECT_EQ(tail.size(), N - index);
+            EXPECT_TRUE(std::equal(list.begin(), list.end(), expected.begin(), expected.begin() + index));
+            EXPECT_TRUE(std::equal(tail.begin(), tail.end(), expected.begin() + index, expected.end()));
+            expect_balanced(list);
+            expect_balanced(tail);
+
+            // glue back in different order
+            tail.concat(list);
+            EXPECT_EQ(list.begin(), list.end());
+            EXPECT_EQ(tail.size(), N);
+            std::rotate(expected.begin(), expected.begin() + index, expected.end());
+            EXPECT_TRUE(std::equal(tail.begin(), tail.end(), expected.begin(), expected.end()));
+            for (int j = 0; j < N; ++j)
+                EXPECT_EQ(tail.at(j), expected[j]);
+            expect_balanced(tail);
+        }
+    }
+
+    // very different heights
+    TreeList<int> small = {1, 2}, big;
+    for (int i = 0; i < 1000; ++i)
+        big.push_back(i);
+    small.concat(big);
+    big.concat(small);
+    big.concat(TreeList<int>{-1});
+    EXPECT_EQ(big.at(0), 1);
+    EXPECT_EQ(big.at(1), 2);
+    EXPECT_EQ(big.at(2), 0);
+    EXPECT_EQ(big.at(1001), 999);
+    EXPECT_EQ(big.at(1002), -1);
+    expect_balanced(big);
+
+    // pools of different lists
+    TreeList<int, PoolAllocator<int>> first = {1, 2, 3}, second = {4, 5};
+    first.concat(second);
+    EXPECT_EQ(std::vector<int>(first.begin(), first.end()), std::vector<int>({1, 2, 3, 4, 5}));
+    auto third = first.split(1);
+    third.concat(first.split(0));
+    EXPECT_EQ(std::vector<int>(third.begin(), third.end()), std::vector<int>({2, 3, 4, 5, 1}));
+    EXPECT_EQ(third.size(), 5);
+    EXPECT_TRUE(first.empty());
+}
+
+TEST(TreeList_test, range_insert_erase){
+    TreeList<int> list;
+    std::vector<int> vec;
+    std::srand(0);
+    for (int i = 0; i < 300; ++i){
+        unsigned long index = std::rand() % (vec.size() + 1);
+        if (std::rand() % 2){
+            std::vector<int> values(std::rand() % 50);
+            for (int& value : values)
+                value = std::rand();
+            vec.insert(vec.begin() + index, values.begin(), values.end());
+            list.insert(index, values.begin(), values.end());
+        } else {
+            unsigned long last = std::min(vec.size(), index + std::rand() % 40);
+            vec.erase(vec.begin() + index, vec.begin() + last);
+            list.erase(index, last);
+        }
+        EXPECT_TRUE(std::equal(list.begin(), list.end(), vec.begin(), vec.end()));
+        EXPECT_EQ(list.size(), vec.size());
+        expect_balanced(list);
+    }
+
+    std::istringstream stream("7 8 9");
+    list.insert(1000000, std::istream_iterator<int>(stream), std::istream_iterator<int>());
+    list.erase(0, vec.size());
+    EXPECT_EQ(std::vector<int>(list.begin(), list.end()), std::vector<int>({7, 8, 9}));
+    list.erase(1, 1000000);
+    EXPECT_EQ(std::vector<int>(list.begin(), list.end()), std::vector<int>({7}));
+
+    {
+        TreeList<ThrowingCopy> throwing;
+        for (int i = 0; i < 100; ++i)
+            throwing.emplace_back(i);
+        std::vector<ThrowingCopy> values(50);
+        for (int position : {0, 20, 49}){ // throws in front, middle or back of the run
+            values[position].value = -1;
+            EXPECT_THROW(throwing.insert(40, values.begin(), values.end()), std::runtime_error);
+            values[position].value = 0;
+            EXPECT_EQ(throwing.size(), 100); // list is left as it was
+            EXPECT_EQ(std::distance(throwing.begin(), throwing.end()), 100);
+            for (int i = 0; i < 100; ++i)
+                EXPECT_EQ(throwing[i].value, i);
+            expect_balanced(throwing);
+            EXPECT_EQ(ThrowingCopy::live, 150);
+        }
+    }
+    EXPECT_EQ(ThrowingCopy::live, 0);
+}
+
+TEST(TreeList_test, batch_edits){
+    TreeList<int, std::allocator<int>, PointerLayout, SumAugment<int>> list;
+    std::vector<int> vec;
+    std::srand(0);
+    for (int round = 0; round < 200; ++round){
+        unsigned long count = std::rand() % (round % 10 == 0 ? 500 : 20);
+        std::vector<std::pair<unsigned long, int>> inserts;
+        for (unsigned long i = 0; i < count; ++i)
+            inserts.emplace_back(std::rand() % (vec.size() + 2), round * 1000 + i); // may be after end
+        std::stable_sort(inserts.begin(), inserts.end(),
+                         [](const auto& a, const auto& b){ return a.first < b.first; });
+        unsigned long size = vec.size();
+        for (auto it = inserts.rbegin(); it != inserts.rend(); ++it) // from the back, so indices stay valid
+            vec.insert(vec.begin() + std::min(it->first, size), it->second);
+        list.insert_batch(inserts);
+
+        std::vector<unsigned long> removes;
+        for (unsigned long i = 0; i < count / 2 + 1; ++i)
+            removes.push_back(std::rand() % (vec.size() + 1)); // may repeat or be missing
+        std::sort(removes.begin(), removes.end());
+        unsigned long last = vec.size();
+        for (auto it = removes.rbegin(); it != removes.rend(); ++it)
+            if (*it < vec.size() and *it != last)
+                vec.erase(vec.begin() + (last = *it));
+        list.remove_batch(removes);
+
+        EXPECT_TRUE(std::equal(list.begin(), list.end(), vec.begin(), vec.end()));
+        EXPECT_EQ(list.size(), vec.size());
+        EXPECT_EQ(list.reduce(0, vec.size()), std::accumulate(vec.begin(), vec.end(), 0));
+        expect_balanced(list);
+    }
+
+    {
+        TreeList<ThrowingCopy> throwing;
+        for (int i = 0; i < 100; ++i)
+            throwing.emplace_back(i);
+        std::vector<std::pair<unsigned long, ThrowingCopy>> inserts;
+        inserts.reserve(100); // growing would copy the throwing value
+        for (unsigned long i = 0; i < 100; ++i)
+            inserts.emplace_back(i, i == 60 ? -1 : 1000);
+        EXPECT_THROW(throwing.insert_batch(inserts), std::runtime_error);
+        EXPECT_EQ(throwing.size(), 100); // list is left as it was
+        EXPECT_EQ(std::distance(throwing.begin(), throwing.end()), 100);
+        for (int i = 0; i < 100; ++i)
+            EXPECT_EQ(throwing[i].value, i);
+        expect_balanced(throwing);
+        inserts.clear();
+        EXPECT_EQ(ThrowingCopy::live, 100);
+    }
+    EXPECT_EQ(ThrowingCopy::live, 0);
+}
+
+// aggregate of subtree has to match what is stored in node
+template <class List>
+void expect_aggregates(const List& list){
+    typedef typename List::NodePtr NodePtr;
+    for (NodePtr node = list.root ? list.root->min() : nullptr; node; node = node->next()) {
+        auto expected = node->aggregate;
+        node->pull();
+        EXPECT_EQ(node->aggregate, expected);
+    }
+}
+
+// polynomial hash of sequence, not commutative
+struct HashAugment {
+    typedef std::pair<unsigned long, unsigned long> value_type; // hash, power
+    static value_type identity() { return {0, 1}; }
+    static value_type lift(int element) { return {element, 31}; }
+    static value_type combine(const value_type& left, const value_type& right) {
+        return {left.first * right.second + right.first, left.second * right.second};
+    }
+};
+
+TEST(TreeList_test, hash_index){
+    typedef TreeList<std::string, std::allocator<std::string>, PointerLayout, NoAugment, NoStats,
+                     HashIndex<std::string>> IndexedList;
+    IndexedList list;
+    std::vector<std::string> vec;
+    auto expect_found = [&](const IndexedList& list, const std::string& value){
+        std::vector<unsigned long> expected;
+        for (unsigned long i = 0; i < vec.size(); ++i)
+            if (vec[i] == value)
+                expected.push_back(i);
+        EXPECT_EQ(list.find_all(value), expected);
+        unsigned long found = list.find(value);
+        if (expected.empty())
+            EXPECT_EQ(found, list.size());
+        else
+            EXPECT_EQ(vec[found], value);
+    };
+
+    std::srand(0);
+    for (int i = 0; i < 3000; ++i){
+        unsigned long index = std::rand() % (vec.size() + 1);
+        std::string value = std::to_string(std::rand() % 100); // plenty of duplicates
+        if (std::rand() % 3 == 0 and not vec.empty()) {
+            index %= vec.size();
+            vec.erase(vec.begin() + index);
+            list.remove(index); // often moves successor's value
+        } else if (std::rand() % 5 == 0 and not vec.empty()) {
+            index %= vec.size();
+            vec[index] = value;
+            list.set(index, value);
+        } else {
+            vec.insert(vec.begin() + index, value);
+            list.insert(index, value);
+        }
+        if (i % 100 == 0)
+            expect_found(list, value);
+    }
+    for (int value = 0; value < 100; ++value)
+        expect_found(list, std::to_string(value));
+    expect_found(list, "absent");
+
+    IndexedList copy(list);
+    list.clear();
+    EXPECT_EQ(list.find("1"), 0);
+    for (int value = 0; value < 100; ++value)
+        expect_found(copy, std::to_string(value));
+    list = std::move(copy);
+    expect_found(list, "42");
+
+    // writing through a reference would leave the entry of old value pointing to the node after it's freed
+    static_assert(std::is_const_v<std::remove_reference_t<decltype(list[0])>>);
+    static_assert(std::is_const_v<std::remove_reference_t<decltype(list.at(0))>>);
+    static_assert(std::is_const_v<std::remove_reference_t<decltype(list.front())>>);
+    static_assert(std::is_const_v<std::remove_reference_t<decltype(*list.begin())>>);
+    static_assert(std::is_const_v<std::remove_reference_t<decltype(*list.cursor())>>);
+    IndexedList small{"1", "2", "3"};
+    small.set(0, "42");
+    small.remove(0);
+    EXPECT_EQ(small.find("1"), small.size());
+    EXPECT_EQ(small.find("42"), small.size());
+    EXPECT_EQ(small.find("3"), 1);
+    small.assign({"1", "2", "3"});
+    small.set(1, "42");
+    small.remove(1); // root with two children, successor's value moves into it
+    EXPECT_EQ(small.find("2"), small.size());
+    EXPECT_EQ(small.find("42"), small.size());
+    EXPECT_EQ(small.find("3"), 1);
+}
 
-void speed_results(unsigned long N){
+TEST(SortedTreeList_test, rank_select){
+    SortedTreeList<int> sorted;
+    std::vector<int> vec; // kept sorted
+    std::srand(0);
+    for (int i = 0; i < 3000; ++i){
+        int value = std::rand() % 500;
+        if (std::rand() % 3 == 0 and not vec.empty()) {
+            unsigned long index = std::rand() % vec.size();
+            vec.erase(vec.begin() + index);
+            sorted.remove(index);
+        } else {
+            unsigned long expected = std::upper_bound(vec.begin(), vec.end(), value) - vec.begin();
+            vec.insert(vec.begin() + expected, value);
+            EXPECT_EQ(sorted.insert_sorted(value), expected);
+        }
+    }
+    EXPECT_TRUE(std::equal(sorted.begin(), sorted.end(), vec.begin(), vec.end()));
+    expect_balanced(sorted.list());
+    for (int value = -1; value <= 500; ++value){
+        EXPECT_EQ(sorted.rank(value), std::lower_bound(vec.begin(), vec.end(), value) - vec.begin());
+        EXPECT_EQ(sorted.upper_rank(value), std::upper_bound(vec.begin(), vec.end(), value) - vec.begin());
+    }
+    for (unsigned long k = 0; k < vec.size(); k += 13)
+        EXPECT_EQ(sorted.select(k), vec[k]);
+
+    EXPECT_FALSE(sorted.erase(1000));
+    int median = sorted.select(sorted.size() / 2);
+    unsigned long copies = sorted.count(median);
+    EXPECT_TRUE(sorted.erase(median));
+    EXPECT_EQ(sorted.count(median), copies - 1);
+
+    SortedTreeList<std::string, std::greater<std::string>> descending = {"b", "d", "a", "c"};
+    descending.insert_sorted("e");
+    EXPECT_EQ(std::vector<std::string>(descending.begin(), descending.end()),
+              std::vector<std::string>({"e", "d", "c", "b", "a"}));
+    EXPECT_EQ(descending.rank("c"), 2);
+}
+
+TEST(FrozenTreeList_test, freeze_thaw){
     TreeList<int> list;
-    std::ofstream fout("results");
+    std::vector<int> vec;
+    for (int i = 0; i < 1000; ++i){
+        list.insert(i / 3, i);
+        vec.insert(vec.begin() + i / 3, i);
+    }
+    FrozenTreeList<int> frozen = list.freeze();
+    EXPECT_FALSE(frozen.has_index());
+    EXPECT_EQ(frozen.size(), vec.size());
+    EXPECT_TRUE(std::equal(frozen.begin(), frozen.end(), vec.begin(), vec.end()));
+    EXPECT_EQ(frozen.at(500), vec[500]);
+    EXPECT_THROW(frozen.at(1000), std::out_of_range);
+
+    TreeList<int> thawed = frozen.thaw();
+    EXPECT_TRUE(std::equal(thawed.begin(), thawed.end(), vec.begin(), vec.end()));
+    expect_balanced(thawed);
+    thawed.remove(0);
+    EXPECT_EQ(frozen[0], vec[0]); // frozen copy doesn't change
+
+    for (int N : {0, 1, 2, 7, 8, 100, 1023}) {
+        std::vector<int> sorted_vec(N);
+        for (int i = 0; i < N; ++i)
+            sorted_vec[i] = i / 3 * 2; // duplicates and gaps
+        SortedTreeList<int> sorted(sorted_vec.begin(), sorted_vec.end());
+        FrozenTreeList<int> searchable = sorted.freeze();
+        EXPECT_TRUE(searchable.has_index());
+        for (int value = -1; value <= N; ++value){
+            EXPECT_EQ(searchable.lower_bound(value),
+                      std::lower_bound(sorted_vec.begin(), sorted_vec.end(), value) - sorted_vec.begin());
+            EXPECT_EQ(searchable.upper_bound(value),
+                      std::upper_bound(sorted_vec.begin(), sorted_vec.end(), value) - sorted_vec.begin());
+            EXPECT_EQ(searchable.contains(value), std::binary_search(sorted_vec.begin(), sorted_vec.end(), value));
+        }
+    }
+}
 
+TEST(TreeList_test, augment){
+    TreeList<int, std::allocator<int>, PointerLayout, SumAugment<int>> sums;
+    TreeList<int, ArenaAllocator<int>, CompactLayout, MinAugment<int>> minimums;
+    TreeList<int, std::allocator<int>, PointerLayout, HashAugment> hashes;
+    std::vector<int> vec;
     std::srand(0);
-    long duration;
-    for (int i = 0; i < N; ++i){
-        fout << i << ' ';
+    for (int i = 0; i < 2000; ++i){
+        unsigned long index = std::rand() % (vec.size() + 1);
+        int value = std::rand() % 1000 - 500, operation = std::rand() % 6;
+        if (operation == 0 and not vec.empty()){
+            index %= vec.size();
+            vec.erase(vec.begin() + index);
+            sums.remove(index);
+            minimums.remove(index);
+            hashes.remove(index);
+        } else if (operation == 1 and not vec.empty()) {
+            index %= vec.size();
+            vec[index] = value;
+            sums.set(index, value);
+            minimums.set(index, value);
+            hashes.set(index, value);
+        } else if (operation == 2) {
+            unsigned long last = std::min(vec.size(), index + std::rand() % 10);
+            vec.erase(vec.begin() + index, vec.begin() + last);
+            sums.erase(index, last);
+            minimums.erase(index, last);
+            hashes.erase(index, last);
+        } else if (operation == 3) {
+            std::vector<int> values(std::rand() % 10, value);
+            vec.insert(vec.begin() + index, values.begin(), values.end());
+            sums.insert(index, values.begin(), values.end());
+            minimums.insert(index, values.begin(), values.end());
+            hashes.insert(index, values.begin(), values.end());
+        } else {
+            vec.insert(vec.begin() + index, value);
+            sums.insert(index, value);
+            minimums.insert(index, value);
+            hashes.insert(index, value);
+        }
 
-        MEASURE_TIME(list.push_back(i), duration)
-        fout << duration << ' ';
+        unsigned long first = std::rand() % (vec.size() + 1), last = std::rand() % (vec.size() + 1);
+        if (first > last)
+            std::swap(first, last);
+        EXPECT_EQ(sums.reduce(first, last), std::accumulate(vec.begin() + first, vec.begin() + last, 0));
+        if (first < last)
+            EXPECT_EQ(minimums.reduce(first, last), *std::min_element(vec.begin() + first, vec.begin() + last));
+        else
+            EXPECT_EQ(minimums.reduce(first, last), MinAugment<int>::identity());
+        auto hash = HashAugment::identity();
+        for (unsigned long j = first; j < last; ++j)
+            hash = HashAugment::combine(hash, HashAugment::lift(vec[j]));
+        EXPECT_EQ(hashes.reduce(first, last), hash);
+    }
+    expect_aggregates(sums);
+    expect_aggregates(minimums);
+    expect_aggregates(hashes);
 
-        // i + 1 elements now
-        int index = std::rand() % (i + 1); // value in [0, i] interval
-        MEASURE_TIME(list.remove(index), duration)
-        fout << duration << ' ';
-        // i elements
+    auto tail = hashes.split(vec.size() / 3);
+    tail.concat(hashes);
+    std::rotate(vec.begin(), vec.begin() + vec.size() / 3, vec.end());
+    auto hash = HashAugment::identity();
+    for (int value : vec)
+        hash = HashAugment::combine(hash, HashAugment::lift(value));
+    EXPECT_EQ(tail.reduce(0, vec.size()), hash);
+    expect_aggregates(tail);
+}
 
-        index = std::rand() % (i + 1);
-        MEASURE_TIME(list.insert(index, i), duration);
-        fout << duration << ' ';
-        // i + 1 elements
+TEST(TreeList_test, cursor){
+    TreeList<int, std::allocator<int>, PointerLayout, SumAugment<int>> list;
+    std::vector<int> vec;
+    auto cursor = list.cursor();
+    EXPECT_TRUE(cursor.at_end());
+    std::srand(0);
+    for (int i = 0; i < 20000; ++i){
+        int operation = std::rand() % 4;
+        if (operation == 0) { // small jump
+            long index = long(cursor.index()) + std::rand() % 9 - 4;
+            cursor.move_to(std::clamp(index, 0l, long(vec.size())));
+        } else if (operation == 1 and i % 100 == 0) { // rare long jump
+            cursor.move_to(std::rand() % (vec.size() + 1));
+        } else if (operation == 2 and not cursor.at_end()) {
+            vec.erase(vec.begin() + cursor.index());
+            cursor.remove();
+        } else if (operation == 3) {
+            vec.insert(vec.begin() + cursor.index(), i);
+            cursor.insert(i);
+        }
+        ASSERT_EQ(cursor.at_end(), cursor.index() == vec.size());
+        if (not cursor.at_end()) {
+            ASSERT_EQ(*cursor, vec[cursor.index()]);
+        }
+    }
+    EXPECT_TRUE(std::equal(list.begin(), list.end(), vec.begin(), vec.end()));
+    EXPECT_EQ(list.size(), vec.size());
+    EXPECT_EQ(list.reduce(0, vec.size()), std::accumulate(vec.begin(), vec.end(), 0));
+    expect_balanced(list);
+    expect_aggregates(list);
 
-        index = std::rand() % (i + 1);
-        MEASURE_TIME(int _ = list.at(index), duration)
-        fout << duration << ' ';
+    cursor.move_to(vec.size() + 100);
+    EXPECT_TRUE(cursor.at_end());
+    EXPECT_EQ(cursor.index(), vec.size());
+    --cursor;
+    EXPECT_EQ(*cursor, vec.back());
+}
 
-        index = std::rand() % (i + 1);
-        MEASURE_TIME(list[index] = 888, duration);
-        fout << duration << '\n';
+// polynomial hash, that knows hash of reversed sequence too
+struct ReversibleHashAugment {
+    struct value_type {
+        unsigned long hash, reversed, power;
+        bool operator==(const value_type& other) const {
+            return hash == other.hash and reversed == other.reversed and power == other.power;
+        }
+    };
+    static value_type identity() { return {0, 0, 1}; }
+    static value_type lift(int element) { return {static_cast<unsigned long>(element), static_cast<unsigned long>(element), 31}; }
+    static value_type combine(const value_type& left, const value_type& right) {
+        return {left.hash * right.power + right.hash, right.reversed * left.power + left.reversed,
+                left.power * right.power};
     }
+    static constexpr bool reversible = true;
+    static void reverse(value_type& aggregate) { std::swap(aggregate.hash, aggregate.reversed); }
+};
 
+TEST(TreeList_test, lazy){
+    TreeList<long, std::allocator<long>, PointerLayout, AddSumAugment<long>> sums;
+    TreeList<int, ArenaAllocator<int>, CompactLayout, ReverseAugment> reversed;
+    TreeList<int, std::allocator<int>, PointerLayout, ReversibleHashAugment> hashes;
+    std::vector<long> vec;
+    std::srand(0);
+    for (int i = 0; i < 2000; ++i){
+        unsigned long index = std::rand() % (vec.size() + 1);
+        unsigned long first = std::rand() % (vec.size() + 1), last = std::rand() % (vec.size() + 1);
+        if (first > last)
+            std::swap(first, last);
+        int value = std::rand() % 1000 - 500, operation = std::rand() % 6;
+        if (operation == 0 and not vec.empty()){
+            index %= vec.size();
+            vec.erase(vec.begin() + index);
+            sums.remove(index);
+            reversed.remove(index);
+            hashes.remove(index);
+        } else if (operation == 1) {
+            for (unsigned long j = first; j < last; ++j)
+                vec[j] += value;
+            sums.apply(first, last, value);
+        } else if (operation == 2) {
+            std::reverse(vec.begin() + first, vec.begin() + last);
+            sums.reverse(first, last);
+            reversed.reverse(first, last);
+            hashes.reverse(first, last);
+        } else if (operation == 3) { // mixed with pending additions, later ones apply on top of it
+            std::fill(vec.begin() + first, vec.begin() + last, value);
+            sums.apply(first, last, AddSumAugment<long>::assign(value));
+        } else {
+            vec.insert(vec.begin() + index, value);
+            sums.insert(index, value);
+            reversed.insert(index, vec[index]);
+            hashes.insert(index, vec[index]);
+        }
+
+        first = std::rand() % (vec.size() + 1);
+        last = std::rand() % (vec.size() + 1);
+        if (first > last)
+            std::swap(first, last);
+        EXPECT_EQ(sums.reduce(first, last).sum, std::accumulate(vec.begin() + first, vec.begin() + last, 0l));
+        if (not vec.empty()) {
+            index = std::rand() % vec.size();
+            EXPECT_EQ(sums.at(index), vec[index]);
+            EXPECT_EQ(reversed.begin() + index - reversed.begin(), index); // index() sees pending reversals
+        }
+    }
+    EXPECT_TRUE(std::equal(sums.begin(), sums.end(), vec.begin(), vec.end()));
+    expect_balanced(sums);
+    expect_balanced(reversed);
+    expect_aggregates(sums);
+    expect_aggregates(hashes);
+
+    // reversed and hashes got values, that were there at insertion time, and only the same reversals
+    TreeList<int> copy(reversed.begin(), reversed.end());
+    auto hash = ReversibleHashAugment::identity();
+    for (int value : copy)
+        hash = ReversibleHashAugment::combine(hash, ReversibleHashAugment::lift(value));
+    EXPECT_EQ(hashes.reduce(0, copy.end() - copy.begin()), hash);
+    EXPECT_TRUE(std::equal(hashes.begin(), hashes.end(), copy.begin(), copy.end()));
 }
 
-void vector_speed(unsigned long N){
-    std::ofstream fout("results-vec");
+template <class Balance>
+unsigned long rotations_with_deletes(){
+    TreeList<int, std::allocator<int>, PointerLayout, NoAugment, CountingStats, NoIndex, Balance> list;
+    std::srand(0);
+    for (int i = 0; i < 20000; ++i)
+        list.insert(std::rand() % (list.size() + 1), i);
+    unsigned long before = list.stats().rotations;
+    for (int i = 0; i < 20000; ++i){ // half of operations are deletes
+        list.remove(std::rand() % list.size());
+        list.insert(std::rand() % (list.size() + 1), i);
+    }
+    expect_balanced(list);
+    return list.stats().rotations - before;
+}
+
+TEST(TreeList_test, wavl_balance){
+    typedef TreeList<int, std::allocator<int>, PointerLayout, NoAugment, NoStats, NoIndex, WavlBalance> List;
+    List list;
     std::vector<int> vec;
+    std::srand(0);
+    for (int i = 0; i < 10000; ++i){
+        unsigned long index = std::rand() % (vec.size() + 1);
+        if (std::rand() % 3 == 0 and not vec.empty()) {
+            index %= vec.size();
+            vec.erase(vec.begin() + index);
+            list.remove(index);
+        } else {
+            vec.insert(vec.begin() + index, i);
+            list.insert(index, i);
+        }
+        if (i % 1000 == 0)
+            expect_balanced(list);
+    }
+    EXPECT_TRUE(std::equal(list.begin(), list.end(), vec.begin(), vec.end()));
+    expect_balanced(list);
+    EXPECT_LE(list.root->height, 2 * std::log2(vec.size()) + 1);
+
+    // split and join compare ranks like AVL heights
+    List tail = list.split(vec.size() / 3);
+    expect_balanced(list);
+    expect_balanced(tail);
+    list.concat(tail);
+    EXPECT_TRUE(std::equal(list.begin(), list.end(), vec.begin(), vec.end()));
+    expect_balanced(list);
+    list.erase(100, 2000);
+    vec.erase(vec.begin() + 100, vec.begin() + 2000);
+    std::vector<int> inserted(vec.begin(), vec.begin() + 1000);
+    list.insert(50, inserted.begin(), inserted.end());
+    vec.insert(vec.begin() + 50, inserted.begin(), inserted.end());
+    std::vector<unsigned long> removed;
+    for (unsigned long j = 0; j < vec.size(); j += 3)
+        removed.push_back(j);
+    list.remove_batch(removed);
+    for (unsigned long j = removed.size(); j-- > 0;)
+        vec.erase(vec.begin() + removed[j]);
+    EXPECT_TRUE(std::equal(list.begin(), list.end(), vec.begin(), vec.end()));
+    expect_balanced(list);
+    check_deque_ends<List>();
+
+    // ranks are read through layout links, which are offsets under CompactLayout
+    TreeList<int, ArenaAllocator<int>, CompactLayout, NoAugment, NoStats, NoIndex, WavlBalance> compact;
+    vec.clear();
+    for (int i = 0; i < 3000; ++i){
+        unsigned long index = std::rand() % (vec.size() + 1);
+        if (std::rand() % 3 == 0 and not vec.empty()) {
+            index %= vec.size();
+            vec.erase(vec.begin() + index);
+            compact.remove(index);
+        } else {
+            vec.insert(vec.begin() + index, i);
+            compact.insert(index, i);
+        }
+    }
+    EXPECT_TRUE(std::equal(compact.begin(), compact.end(), vec.begin(), vec.end()));
+    expect_balanced(compact);
+
+    TreeList<long, std::allocator<long>, PointerLayout, AddSumAugment<long>, NoStats, NoIndex, WavlBalance> sums;
+    for (long i = 0; i < 1000; ++i)
+        sums.push_back(i);
+    sums.reverse(100, 900);
+    sums.apply(0, 500, 1l);
+    for (int i = 0; i < 300; ++i)
+        sums.remove(std::rand() % sums.size());
+    expect_balanced(sums);
+    EXPECT_EQ(sums.reduce(0, sums.size()).sum, std::accumulate(sums.begin(), sums.end(), 0l));
+
+    EXPECT_LT(rotations_with_deletes<WavlBalance>(), rotations_with_deletes<AvlBalance>());
+}
+
+// common interface of TreeList and ChunkList
+template <class List>
+class List_test : public testing::Test {};
+
+typedef TreeList<int, std::allocator<int>, PointerLayout, NoAugment, NoStats, NoIndex, WavlBalance> WavlList;
+typedef testing::Types<TreeList<int>, WavlList, ChunkList<int>, ChunkList<int, 4, 4>, PersistentTreeList<int>> ListTypes;
+TYPED_TEST_SUITE(List_test, ListTypes);
 
+TYPED_TEST(List_test, random_edits){
+    TypeParam list;
+    std::vector<int> vec;
     std::srand(0);
-    long duration;
+    for (int i = 0; i < 5000; ++i){
+        unsigned long index = std::rand() % (vec.size() + 1);
+        int operation = std::rand() % 5;
+        if (operation < 2 and not vec.empty()) {
+            index %= vec.size();
+            vec.erase(vec.begin() + index);
+            list.remove(index);
+        } else if (operation == 2) {
+            vec.push_back(i);
+            list.push_back(i);
+        } else {
+            vec.insert(vec.begin() + index, i);
+            list.insert(index, i);
+        }
+        if (i % 100 == 0) {
+            EXPECT_TRUE(std::equal(list.begin(), list.end(), vec.begin(), vec.end()));
+            EXPECT_EQ(list.size(), vec.size());
+        }
+    }
+    for (int j = 0; j < vec.size(); ++j)
+        EXPECT_EQ(list.at(j), vec[j]);
+    list.remove(vec.size()); // no such index
+    EXPECT_THROW(list.at(vec.size()), std::out_of_range);
 
-    for (int i = 0; i < N; ++i){
-        fout << i << ' ';
+    // drain from the front, exercises merging of small blocks
+    while (not vec.empty()){
+        unsigned long index = std::rand() % std::min<unsigned long>(vec.size(), 3);
+        vec.erase(vec.begin() + index);
+        list.remove(index);
+    }
+    EXPECT_EQ(list.begin(), list.end());
+    list.push_back(1);
+    EXPECT_EQ(list.at(0), 1);
+}
 
-        MEASURE_TIME(vec.push_back(i), duration)
-        fout << duration << ' ';
+TEST(ChunkList_test, iteration){
+    ChunkList<int, 4, 4> list;
+    std::vector<int> vec;
+    for (int i = 0; i < 1000; ++i){
+        list.insert(i / 3, i);
+        vec.insert(vec.begin() + i / 3, i);
+    }
+    EXPECT_EQ(list.size(), vec.size());
+    EXPECT_TRUE(std::equal(list.begin(), list.end(), vec.begin(), vec.end()));
+    auto it = list.end();
+    for (auto vit = vec.end(); vit != vec.begin();)
+        EXPECT_EQ(*--it, *--vit);
+    EXPECT_EQ(it, list.begin());
+
+    ChunkList<int, 4, 4> copy(list);
+    list.clear();
+    EXPECT_TRUE(std::equal(copy.begin(), copy.end(), vec.begin(), vec.end()));
+    // failed copy changes nothing, both in full leaves and in ones with free space
+    ChunkList<ThrowingCopy, 4, 4> throwing;
+    std::vector<ThrowingCopy> values;
+    for (int i = 0; i < 200; ++i){
+        EXPECT_THROW(throwing.insert(i / 2, ThrowingCopy(-1)), std::runtime_error);
+        EXPECT_EQ(throwing.size(), values.size());
+        throwing.insert(i / 2, ThrowingCopy(i));
+        values.insert(values.begin() + i / 2, ThrowingCopy(i));
+        EXPECT_EQ(throwing.at(i / 2).value, i);
+    }
+    EXPECT_TRUE(std::equal(throwing.begin(), throwing.end(), values.begin(), values.end()));
+    EXPECT_THROW(throwing.at(values.size()), std::out_of_range);
+}
+
+TEST(PersistentTreeList_test, snapshots){
+    PersistentTreeList<int> list;
+    std::vector<int> vec;
+    std::vector<PersistentTreeList<int>::Snapshot> snapshots;
+    std::vector<std::vector<int>> expected;
+    std::srand(0);
+    for (int i = 0; i < 3000; ++i){
+        unsigned long index = std::rand() % (vec.size() + 1);
+        int operation = std::rand() % 4;
+        if (operation == 0 and not vec.empty()) {
+            index %= vec.size();
+            vec.erase(vec.begin() + index);
+            list.remove(index);
+        } else if (operation == 1 and not vec.empty()) {
+            index %= vec.size();
+            vec[index] = -i;
+            list.set(index, -i);
+        } else {
+            vec.insert(vec.begin() + index, i);
+            list.insert(index, i);
+        }
+        if (i % 100 == 0) {
+            snapshots.push_back(list.snapshot());
+            expected.push_back(vec);
+        }
+    }
+    EXPECT_TRUE(std::equal(list.begin(), list.end(), vec.begin(), vec.end()));
+    for (unsigned long j = 0; j < snapshots.size(); ++j) {
+        EXPECT_EQ(snapshots[j].size(), expected[j].size());
+        EXPECT_TRUE(std::equal(snapshots[j].begin(), snapshots[j].end(), expected[j].begin(), expected[j].end()));
+    }
 
-        // i + 1 elements now
-        int index = std::rand() % (i + 1); // value in [0, i] interval
-        MEASURE_TIME(vec.erase(vec.begin()+index), duration)
-        fout << duration << ' ';
-        // i elements
+    PersistentTreeList<int> branch(snapshots[5]); // snapshot can become modifiable list again
+    branch.push_back(42);
+    EXPECT_EQ(branch.size(), expected[5].size() + 1);
+    EXPECT_EQ(snapshots[5].size(), expected[5].size());
+    EXPECT_THROW(snapshots[5].at(expected[5].size()), std::out_of_range);
+}
 
-        index = std::rand() % (i + 1);
-        MEASURE_TIME(vec.insert(vec.begin()+index, i), duration);
-        fout << duration << ' ';
-        // i + 1 elements
+// readers check snapshots in other threads while the only writer keeps appending
+TEST(PersistentTreeList_test, concurrent_readers){
+    PersistentTreeList<int> list;
+    std::vector<PersistentTreeList<int>::Snapshot> published(4);
+    std::atomic<unsigned long> version{0};
+    std::atomic<bool> done{false}, ok{true};
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 4; ++r)
+        readers.emplace_back([&]{
+            while (not done) {
+                unsigned long v = version.load();
+                if (v == 0)
+                    continue;
+                PersistentTreeList<int>::Snapshot snapshot = published[v - 1]; // copied in reader thread
+                int expected = 0;
+                for (int value : snapshot)
+                    if (value != expected++)
+                        ok = false;
+            }
+        });
+    for (int i = 0; i < 20000; ++i) {
+        list.push_back(i);
+        if (i % 500 == 0 and version < 4) {
+            published[version] = list.snapshot();
+            ++version;
+        }
+        if (i % 1000 == 999) { // modify nodes, that are shared with snapshots
+            list.remove(i);
+            list.insert(i, i);
+        }
+    }
+    done = true;
+    for (std::thread& reader : readers)
+        reader.join();
+    EXPECT_TRUE(ok);
+}
 
-        index = std::rand() % (i + 1);
-        MEASURE_TIME(int _ = vec.at(index), duration)
-        fout << duration << ' ';
+// writers and readers at the same time, every writer's values have to come in its order
+TEST(ConcurrentTreeList_test, writers_and_readers){
+    ConcurrentTreeList<int> list;
+    std::vector<std::thread> threads;
+    std::atomic<bool> ok{true};
+    const int writers = 4, count = 5000;
+    for (int w = 0; w < writers; ++w)
+        threads.emplace_back([&, w]{
+            for (int i = 0; i < count; ++i) {
+                list.push_back(w * count + i);
+                list.insert(0, -1);
+                list.remove(0);
+            }
+        });
+    for (int r = 0; r < 2; ++r)
+        threads.emplace_back([&]{
+            for (int i = 0; i < 1000; ++i)
+                list.read([&](const TreeList<int>& snapshot){
+                    std::vector<int> last(writers, -1);
+                    for (int value : snapshot) {
+                        if (value < 0)
+                            continue;
+                        if (value <= last[value / count])
+                            ok = false;
+                        last[value / count] = value;
+                    }
+                });
+        });
+    for (std::thread& thread : threads)
+        thread.join();
+    EXPECT_TRUE(ok);
+    EXPECT_EQ(list.size(), writers * count);
+    list.set(0, 7);
+    list.set(writers * count, 7); // no such index
+    EXPECT_EQ(list.at(0), 7);
+    EXPECT_THROW(list.at(writers * count), std::out_of_range);
+}
+
+TEST(ConcurrentTreeList_test, throwing_operation){
+    ConcurrentTreeList<ThrowingCopy> list;
+    std::vector<std::thread> threads;
+    std::atomic<int> thrown{0};
+    const int writers = 4, count = 2000;
+    for (int w = 0; w < writers; ++w)
+        threads.emplace_back([&, w]{
+            for (int i = 0; i < count; ++i) {
+                try {
+                    list.push_back(ThrowingCopy(i % 10 == 0 ? -1 : i)); // fails in whatever batch it lands
+                } catch (const std::runtime_error&) {
+                    ++thrown;
+                }
+            }
+        });
+    for (std::thread& thread : threads)
+        thread.join();
+    EXPECT_EQ(thrown, writers * count / 10);
+    EXPECT_EQ(list.size(), writers * count * 9 / 10);
+    EXPECT_THROW(list.insert(0, ThrowingCopy(-1)), std::runtime_error);
+    list.insert(0, ThrowingCopy(5)); // combiner lock was released
+    EXPECT_EQ(list.at(0).value, 5);
+}
+
+TEST(ParallelAlgorithms_test, algorithms){
+    ThreadPool pool(4);
+    std::vector<long> vec(100000); // sums of the whole range overflow int
+    std::iota(vec.begin(), vec.end(), 0);
+    TreeList<long, std::allocator<long>, PointerLayout, SumAugment<long>> list(vec.begin(), vec.end());
+
+    parallel_transform(list, [](long value){ return value % 1000; }, pool);
+    for (long& value : vec)
+        value %= 1000;
+    EXPECT_TRUE(std::equal(list.begin(), list.end(), vec.begin(), vec.end()));
+    expect_aggregates(list);
+
+    std::atomic<long> sum{0};
+    parallel_for_each(list, [&](long& value){ sum += value; }, pool);
+    EXPECT_EQ(sum, std::accumulate(vec.begin(), vec.end(), 0l));
+    EXPECT_EQ(parallel_reduce(list, 0l, std::plus<long>(), pool), sum);
+    EXPECT_EQ(parallel_count_if(list, [](long value){ return value % 3 == 0; }, pool),
+              std::count_if(vec.begin(), vec.end(), [](long value){ return value % 3 == 0; }));
+
+    // order matters for reduce, pending lazy updates are pushed by workers
+    TreeList<long, std::allocator<long>, PointerLayout, AddSumAugment<long>> lazy(vec.begin(), vec.end());
+    lazy.apply(100, 90000, 1);
+    lazy.reverse(0, 50000);
+    for (unsigned long i = 100; i < 90000; ++i)
+        ++vec[i];
+    std::reverse(vec.begin(), vec.begin() + 50000);
+    auto concatenation = [](const std::string& a, const std::string& b){ return a + b; };
+    auto digits = [](const std::vector<long>& values, unsigned long first, unsigned long last){
+        std::string result;
+        for (unsigned long i = first; i < last; ++i)
+            result += char('0' + values[i] % 10);
+        return result;
+    };
+    TreeList<long, std::allocator<long>, PointerLayout, AddSumAugment<long>> lazy_copy(lazy);
+    parallel_transform(lazy_copy, [](long value){ return value % 10; }, pool);
+    TreeList<std::string> strings;
+    for (long value : lazy_copy)
+        strings.push_back(std::string(1, char('0' + value)));
+    EXPECT_EQ(parallel_reduce(strings, std::string(), concatenation, pool), digits(vec, 0, vec.size()));
+    EXPECT_EQ(lazy.reduce(0, vec.size()).sum, parallel_reduce(lazy, 0l, std::plus<long>(), pool));
+}
 
-        index = std::rand() % (i + 1);
-        MEASURE_TIME(vec.at(index) = 888, duration);
-        fout << duration << '\n';
+TEST(ParallelAlgorithms_test, throwing_function){
+    ThreadPool pool(4);
+    std::vector<int> vec(100000);
+    std::iota(vec.begin(), vec.end(), 0);
+    TreeList<int> list(vec.begin(), vec.end());
+    for (int bad : {0, 50000, 99999}) { // thrown by forking thread, by forked task, by the last one
+        std::atomic<long> visited{0};
+        EXPECT_THROW(parallel_for_each(list, [&](int value){
+            if (value == bad)
+                throw std::runtime_error("bad value");
+            ++visited;
+        }, pool), std::runtime_error);
+        EXPECT_LT(visited, vec.size());
     }
+    // pool still works and its workers wake up for new tasks
+    EXPECT_EQ(parallel_count_if(list, [](int value){ return value % 2 == 0; }, pool), vec.size() / 2);
 }
 
 int main(int argc, char** argv){